@@ -1,6 +1,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 
 // windows.h must be included before GL headers
 #ifdef _MSC_VER
@@ -12,6 +13,9 @@
 #include <GL/glext.h>
 #endif
 
+#include "bmp_loader.h"
+#include "telemetry.h"
+
 /*
  * This code is partially taken from http://www.opengl-tutorial.org/beginners-tutorials/tutorial-5-a-textured-cube/
  * Structs are taken from Wikipedia
@@ -66,19 +70,31 @@ GLuint loadBMPTexture(const char *filename) {
         return 0;
     }
 
-    GLubyte *data = (GLubyte*) malloc(info.sizeImage);
+    GLubyte *data = (GLubyte*) telemetryMalloc(info.sizeImage);
     fread(data, 1, info.sizeImage, bmp);
     fclose(bmp);
 
     GLuint texture;
     glGenTextures(1, &texture);
+    telemetryCountGLCreate();
 
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, info.width, info.height, 0, GL_BGR, GL_UNSIGNED_BYTE, data);
+    telemetryCountUpload(info.sizeImage);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 
-    free(data);
+    telemetryFree(data);
 
     return texture;
 }
+
+void fillBMPHeader(GLubyte header[BMP_HEADER_SIZE], GLint width, GLint height) {
+    GLuint row = (width * 3 + 3) & ~3; // Rows are padded to 4 bytes, just like GL_PACK_ALIGNMENT 4 does
+
+    BMPFileHeader hdr = {0x4d42, (GLuint) (BMP_HEADER_SIZE + row * height), 0, 0, BMP_HEADER_SIZE}; // "BM"
+    BMPInfoHeader info = {sizeof(BMPInfoHeader), width, height, 1, 24, 0, row * height, 2835, 2835, 0, 0}; // 72 DPI
+
+    memcpy(header, &hdr, sizeof(hdr));
+    memcpy(header + sizeof(hdr), &info, sizeof(info));
+}
@@ -9,6 +9,11 @@
 
 #include <GL/gl.h>
 
+#define BMP_HEADER_SIZE 54 // File and info headers of an uncompressed 24-bit image
+
 GLuint loadBMPTexture(const char *filename);
 
+// Header for bottom-up BGR rows padded to 4 bytes, i.e. what glReadPixels(GL_BGR) gives by default
+void fillBMPHeader(GLubyte header[BMP_HEADER_SIZE], GLint width, GLint height);
+
 #endif
@@ -6,6 +6,11 @@
 #define HEIGHT 600
 #define FPS 100
 
+#define CAMERA_SPEED 0.25f         // Scene units per second, multiplied by speed factor
+#define CAMERA_ANGULAR_SPEED 0.6f  // Radians per second
+#define MOUSE_SENSITIVITY 0.003f   // Radians per pixel
+#define MAX_FRAME_TIME 0.1f        // Longer frames (e.g. window dragging) do not throw the camera away, seconds
+
 #define ASTRONOMIC_UNIT 100.0f
 
 #define SUN_RADIUS (EARTH_RADIUS * 109)
@@ -26,4 +31,19 @@
 
 #define DAYS_PER_SECOND 0.001f
 
+#define TRAIL_DAYS 1.0            // Default history length, days
+#define TRAIL_SAMPLES 256         // Ring slots per body
+#define TRAIL_MAX_BODIES 4096     // Planets with moons and N-body particles that get trails, the first ones of each
+
+#define SUBPIXEL_RADIUS 0.5 // Bodies smaller than this on the screen are not drawn, pixels
+
+// Gravitational parameter of the Sun in scene units (ASTRONOMIC_UNIT^3 / day^2)
+#define GAUSSIAN_GRAVITY_CONSTANT 0.01720209895
+#define SUN_GM (GAUSSIAN_GRAVITY_CONSTANT * GAUSSIAN_GRAVITY_CONSTANT * ASTRONOMIC_UNIT * ASTRONOMIC_UNIT * ASTRONOMIC_UNIT)
+
+#define NBODY_PARTICLES 20000 // Test particles seeded into the asteroid belt
+#define NBODY_SOFTENING (EARTH_RADIUS * 0.5) // Keeps close encounters finite
+#define NBODY_TREE_THRESHOLD 64 // Use Barnes-Hut instead of direct sum above this number of massive bodies
+#define NBODY_TREE_THETA 0.5 // Barnes-Hut opening angle
+
 #endif
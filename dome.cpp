@@ -0,0 +1,395 @@
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <GL/glu.h>
+
+#include <vector>
+
+#include "constants.h"
+#include "dome.h"
+#include "gl_extensions.h"
+#include "rendering.h"
+#include "telemetry.h"
+
+#define DOME_VERTEX_FLOATS 5 // Position on the output, then view direction
+
+static bool enabled = false;
+static DomeProjection projection = DOME_FISHEYE;
+
+static GLuint framebuffer = 0, cube_texture = 0, depth_buffer = 0;
+static GLint face_size = 0;
+
+// Four vertices per mesh cell, in client memory or in mesh_buffer if there is one
+static std::vector<GLfloat> mesh;
+static GLuint mesh_buffer = 0;
+static bool faces_used[6];
+
+// An orbit or a body that at least one face sees, found once per frame for all of them
+struct DomeItem {
+    const Planet *planet;
+    GLfloat frame[16]; // orbitFrame() for an orbit, bodyFrame() for a body
+    unsigned faces;    // Bit per cube face
+    bool orbit;
+};
+
+static std::vector<DomeItem> items; // Kept between frames, so culling does not allocate
+static unsigned sun_faces = 0;
+static GLfloat eye[3], eye_basis[9]; // Camera of the frame being culled, basis as in domeRender()
+
+// View direction and up of every face in eye space, in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+static const GLfloat face_axes[6][6] = {
+    { 1.0f,  0.0f,  0.0f,   0.0f, -1.0f,  0.0f},
+    {-1.0f,  0.0f,  0.0f,   0.0f, -1.0f,  0.0f},
+    { 0.0f,  1.0f,  0.0f,   0.0f,  0.0f,  1.0f},
+    { 0.0f, -1.0f,  0.0f,   0.0f,  0.0f, -1.0f},
+    { 0.0f,  0.0f,  1.0f,   0.0f, -1.0f,  0.0f},
+    { 0.0f,  0.0f, -1.0f,   0.0f, -1.0f,  0.0f}
+};
+
+// Face a direction is looked up in
+static int cubeFace(const GLfloat direction[3]) {
+    GLfloat x = fabsf(direction[0]), y = fabsf(direction[1]), z = fabsf(direction[2]);
+    if (x >= y && x >= z)
+        return direction[0] > 0.0f ? 0 : 1;
+    if (y >= z)
+        return direction[1] > 0.0f ? 2 : 3;
+    return direction[2] > 0.0f ? 4 : 5;
+}
+
+// s and t go from 0 to 1 across the mesh, output is the unit square
+static void addMeshVertex(GLfloat s, GLfloat t) {
+    GLfloat x, y, direction[3];
+    if (projection == DOME_FISHEYE) {
+        GLfloat angle = 2 * M_PI * s, zenith = t * DOME_FISHEYE_FOV * M_PI / 360.0f;
+        x = 0.5f + 0.5f * t * cosf(angle);
+        y = 0.5f + 0.5f * t * sinf(angle);
+        direction[0] = sinf(zenith) * cosf(angle);
+        direction[1] = sinf(zenith) * sinf(angle);
+        direction[2] = -cosf(zenith);
+    } else {
+        GLfloat longitude = (s - 0.5f) * 2 * M_PI, latitude = (t - 0.5f) * M_PI;
+        x = s;
+        y = t;
+        direction[0] = cosf(latitude) * sinf(longitude);
+        direction[1] = sinf(latitude);
+        direction[2] = -cosf(latitude) * cosf(longitude);
+    }
+
+    faces_used[cubeFace(direction)] = true;
+    mesh.push_back(x);
+    mesh.push_back(y);
+    mesh.insert(mesh.end(), direction, direction + 3);
+}
+
+static void buildMesh() {
+    mesh.clear();
+    for (int i = 0; i < 6; i++)
+        faces_used[i] = false;
+
+    for (int row = 0; row < DOME_MESH_ROWS; row++)
+        for (int column = 0; column < DOME_MESH_COLUMNS; column++) {
+            GLfloat s0 = (GLfloat) column / DOME_MESH_COLUMNS, s1 = (GLfloat) (column + 1) / DOME_MESH_COLUMNS;
+            GLfloat t0 = (GLfloat) row / DOME_MESH_ROWS, t1 = (GLfloat) (row + 1) / DOME_MESH_ROWS;
+            addMeshVertex(s0, t0);
+            addMeshVertex(s1, t0);
+            addMeshVertex(s1, t1);
+            addMeshVertex(s0, t1);
+        }
+
+    // Cube map lookups do not need unit vectors, so directions between vertices are fine as they are
+    if (glHasBuffers) {
+        pglGenBuffers(1, &mesh_buffer);
+        pglBindBuffer(GL_ARRAY_BUFFER, mesh_buffer);
+        pglBufferData(GL_ARRAY_BUFFER, mesh.size() * sizeof(GLfloat), &mesh[0], GL_STATIC_DRAW);
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+        telemetryCountGLCreate();
+        telemetryCountUpload(mesh.size() * sizeof(GLfloat));
+    }
+}
+
+bool domeInit(DomeProjection dome_projection) {
+    if (!glHasFramebuffers) {
+        fprintf(stderr, "Dome output needs OpenGL framebuffer objects\n");
+        return false;
+    }
+
+    projection = dome_projection;
+    buildMesh();
+    enabled = true;
+    return true;
+}
+
+static bool resizeFaces(GLint size) {
+    if (size == face_size)
+        return true;
+
+    if (!framebuffer) {
+        pglGenFramebuffers(1, &framebuffer);
+        glGenTextures(1, &cube_texture);
+        pglGenRenderbuffers(1, &depth_buffer);
+        telemetryCountGLCreate(3);
+    }
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cube_texture);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    for (int i = 0; i < 6; i++)
+        glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    // One depth buffer for all faces, each is cleared before it is drawn
+    pglBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+    pglRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size, size);
+    pglBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X, cube_texture, 0);
+    pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
+    bool complete = pglCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Given up for good, so the usual view is not held up by retrying every frame
+    if (!complete) {
+        fprintf(stderr, "Cannot render dome faces of %dx%d, showing the usual view\n", size, size);
+        enabled = false;
+    }
+    face_size = complete ? size : 0;
+    return complete;
+}
+
+// Eye space vector of the camera with the given basis, in world space
+static void eyeToWorld(const GLfloat eye[3], const GLfloat basis[9], GLfloat world[3]) {
+    for (int i = 0; i < 3; i++)
+        world[i] = eye[0] * basis[i] + eye[1] * basis[3 + i] + eye[2] * basis[6 + i];
+}
+
+static void normalize(GLfloat *v) {
+    GLfloat length = sqrtf(v[0]*v[0] + v[1]*v[1] + v[2]*v[2]);
+    v[0] /= length; v[1] /= length; v[2] /= length;
+}
+
+// Faces a sphere shows up in, tested against the four side planes of each 90 degree face frustum
+static unsigned sphereFaces(const GLfloat center[3], GLfloat r, bool drop_subpixel) {
+    GLfloat p[3] = {center[0] - eye[0], center[1] - eye[1], center[2] - eye[2]}, e[3];
+    for (int i = 0; i < 3; i++)
+        e[i] = p[0] * eye_basis[3*i] + p[1] * eye_basis[3*i + 1] + p[2] * eye_basis[3*i + 2];
+
+    unsigned faces = 0;
+    for (int face = 0; face < 6; face++) {
+        if (!faces_used[face])
+            continue;
+
+        int axis = face / 2;
+        GLfloat depth = face % 2 ? -e[axis] : e[axis];
+        GLfloat a = fabsf(e[(axis + 1) % 3]), b = fabsf(e[(axis + 2) % 3]);
+        if (depth + r <= 0 || depth - a < -r * (GLfloat) M_SQRT2 || depth - b < -r * (GLfloat) M_SQRT2)
+            continue;
+
+        // Smaller than a pixel, as in Planet::render(); focal length of a face is half its size
+        if (drop_subpixel && r * face_size / 2 < depth * SUBPIXEL_RADIUS)
+            continue;
+        faces |= 1u << face;
+    }
+    return faces;
+}
+
+// Same traversal and culling as Planet::render(), but against all faces at once
+static void cullBodies(const std::vector<Planet> &bodies, const GLfloat *parent, bool orbits) {
+    for (auto it = bodies.begin(); it != bodies.end(); it++) {
+        DomeItem item;
+        item.planet = &*it;
+        it->orbitFrame(item.frame, parent);
+
+        // Whole orbit is off every face: no need to even know where the body is
+        unsigned system_faces = sphereFaces(item.frame + 12, it->extent(), false);
+        if (!system_faces)
+            continue;
+        if (orbits) {
+            item.faces = system_faces;
+            item.orbit = true;
+            items.push_back(item);
+        }
+
+        it->bodyFrame(item.frame, parent);
+        cullBodies(it->getMoons(), item.frame, orbits);
+
+        item.faces = sphereFaces(item.frame + 12, it->getRadius(), true);
+        item.orbit = false;
+        if (item.faces)
+            items.push_back(item);
+    }
+}
+
+// drawScene() with what the culling pass found for this face
+static void drawFace(int face, const GLfloat camera[9], bool particles, bool trails) {
+    beginScene(camera);
+    drawSky();
+    if (sun_faces & (1u << face))
+        drawSun();
+
+    glColor3f(1.0f, 1.0f, 1.0f);
+    for (auto it = items.begin(); it != items.end(); it++) {
+        if (!(it->faces & (1u << face)))
+            continue;
+
+        glPushMatrix();
+        glMultMatrixf(it->frame);
+        if (it->orbit)
+            it->planet->renderOrbit();
+        else
+            it->planet->renderSphere();
+        glPopMatrix();
+    }
+
+    if (particles)
+        nbody.render();
+    if (trails)
+        drawTrails(particles);
+}
+
+static void drawMesh(const GLint viewport[4]) {
+    if (projection == DOME_FISHEYE) { // Centered square
+        GLint side = viewport[2] < viewport[3] ? viewport[2] : viewport[3];
+        glViewport(viewport[0] + (viewport[2] - side) / 2, viewport[1] + (viewport[3] - side) / 2, side, side);
+    }
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    gluOrtho2D(0.0, 1.0, 0.0, 1.0);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE); // Fisheye cells wind clockwise
+    glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_TEXTURE_CUBE_MAP);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, cube_texture);
+    glColor3f(1.0f, 1.0f, 1.0f);
+
+    const GLfloat *vertices = &mesh[0];
+    if (mesh_buffer) {
+        pglBindBuffer(GL_ARRAY_BUFFER, mesh_buffer);
+        vertices = NULL;
+    }
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(2, GL_FLOAT, DOME_VERTEX_FLOATS * sizeof(GLfloat), vertices);
+    glTexCoordPointer(3, GL_FLOAT, DOME_VERTEX_FLOATS * sizeof(GLfloat), vertices + 2);
+    glDrawArrays(GL_QUADS, 0, mesh.size() / DOME_VERTEX_FLOATS);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    if (mesh_buffer)
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+    glDisable(GL_TEXTURE_CUBE_MAP);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_LIGHTING);
+
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+bool domeRender(const GLfloat camera[9], bool orbits, bool particles, bool trails) {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // Face resolution matching the output's in its middle, where a face is half as many pixels across as per radian
+    GLfloat pixels_per_radian = projection == DOME_FISHEYE ?
+        (viewport[2] < viewport[3] ? viewport[2] : viewport[3]) / (DOME_FISHEYE_FOV * (GLfloat) M_PI / 180.0f) :
+        viewport[2] / (2 * (GLfloat) M_PI);
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_CUBE_MAP_TEXTURE_SIZE, &max_size);
+    GLint size = (GLint) (2 * pixels_per_radian + 0.5f);
+    if (size > max_size)
+        size = max_size;
+    if (size < DOME_MIN_FACE)
+        size = DOME_MIN_FACE;
+    if (!resizeFaces(size))
+        return false;
+
+    // Eye space x, y and z axes in world space: side, up and back
+    GLfloat *basis = eye_basis;
+    basis[6] = -camera[3]; basis[7] = -camera[4]; basis[8] = -camera[5];
+    normalize(basis + 6);
+    basis[0] = camera[4] * camera[8] - camera[5] * camera[7];
+    basis[1] = camera[5] * camera[6] - camera[3] * camera[8];
+    basis[2] = camera[3] * camera[7] - camera[4] * camera[6];
+    normalize(basis);
+    basis[3] = basis[7] * basis[2] - basis[8] * basis[1];
+    basis[4] = basis[8] * basis[0] - basis[6] * basis[2];
+    basis[5] = basis[6] * basis[1] - basis[7] * basis[0];
+
+    // One culling pass for every face, bodies are placed once and their frames reused
+    eye[0] = camera[0]; eye[1] = camera[1]; eye[2] = camera[2];
+    static const GLfloat origin[3] = {0.0f, 0.0f, 0.0f};
+    sun_faces = sphereFaces(origin, SUN_RADIUS, false);
+    items.clear();
+    cullBodies(planets, NULL, orbits);
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    setPerspective(face_size, face_size, 90.0f);
+
+    for (int face = 0; face < 6; face++) {
+        if (!faces_used[face])
+            continue;
+
+        pglFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, cube_texture, 0);
+        GLfloat face_camera[9] = {camera[0], camera[1], camera[2]};
+        eyeToWorld(face_axes[face], basis, face_camera + 3);
+        eyeToWorld(face_axes[face] + 3, basis, face_camera + 6);
+        drawFace(face, face_camera, particles, trails);
+    }
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    drawMesh(viewport);
+    return true;
+}
+
+bool domeEnabled() {
+    return enabled;
+}
+
+void domeFree() {
+    if (framebuffer) {
+        pglDeleteFramebuffers(1, &framebuffer);
+        glDeleteTextures(1, &cube_texture);
+        pglDeleteRenderbuffers(1, &depth_buffer);
+        telemetryCountGLDelete(3);
+    }
+    framebuffer = cube_texture = depth_buffer = 0;
+    face_size = 0;
+
+    if (mesh_buffer) {
+        pglDeleteBuffers(1, &mesh_buffer);
+        telemetryCountGLDelete();
+    }
+    mesh_buffer = 0;
+    mesh.clear();
+    std::vector<DomeItem>().swap(items);
+    enabled = false;
+}
@@ -0,0 +1,42 @@
+
+#ifndef DOME_H
+#define DOME_H
+
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+#define DOME_FISHEYE_FOV 180.0f // Degrees across the dome
+#define DOME_MESH_COLUMNS 128   // Reprojection mesh: around the fisheye or along the longitude
+#define DOME_MESH_ROWS 64       // From the fisheye center out or along the latitude
+#define DOME_MIN_FACE 64        // Pixels, cube faces never get smaller than that
+
+enum DomeProjection {
+    DOME_FISHEYE,       // Dome master: circle in the middle of the window, view direction at its center
+    DOME_EQUIRECTANGULAR // Whole sphere over the window, view direction in the middle
+};
+
+/*
+ * Dome output: the scene is drawn once per face of a cube map around the
+ * camera, then the cube map is laid over the window with a mesh whose
+ * texture coordinates are view directions. Camera up stays up on the output.
+ *
+ * Only faces the projection reaches are drawn (five of the six for a 180
+ * degree fisheye). Faces are drawn one after another, as layered rendering
+ * needs shaders, but they share everything that does not depend on the view:
+ * planets are evaluated once per frame, particles and trails are uploaded
+ * once, textures are bound from the same objects. Bodies and orbits are
+ * culled in one pass against all face frusta, which keeps each body's frame
+ * and the mask of faces that see it, so a face only submits what it sees.
+ *
+ * Body labels are not shown, they are placed in a single perspective view.
+ */
+bool domeInit(DomeProjection projection); // Needs framebuffer objects
+// Into the current viewport, false if the faces cannot be drawn (then nothing is)
+bool domeRender(const GLfloat camera[9], bool orbits, bool particles, bool trails);
+bool domeEnabled();
+void domeFree();
+
+#endif
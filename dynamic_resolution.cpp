@@ -0,0 +1,184 @@
+#include <math.h>
+#include <stdio.h>
+
+#include <SDL.h>
+
+#include "constants.h"
+#include "dynamic_resolution.h"
+#include "gl_extensions.h"
+#include "telemetry.h"
+
+static bool enabled = false;
+static float budget = 0.0f;   // Seconds
+static float scale = 1.0f;
+static float average = 0.0f;  // Scene cost, seconds
+
+static GLuint framebuffer = 0, color_buffer = 0, depth_buffer = 0;
+static GLint target_width = 0, target_height = 0;
+static GLint window_viewport[4];
+static GLint scene_width = 0, scene_height = 0;
+static bool offscreen = false;
+
+static GLuint queries[DYNRES_QUERIES];
+static unsigned next_query = 0, pending_queries = 0;
+static bool timing = false;
+static Uint64 last_counter = 0;
+
+bool dynamicResolutionInit(float budget_ms) {
+    if (!glHasFramebuffers) {
+        fprintf(stderr, "Dynamic resolution needs OpenGL framebuffer objects\n");
+        return false;
+    }
+
+    budget = budget_ms / 1000.0f;
+    enabled = budget > 0.0f;
+    if (enabled && glHasTimerQueries) {
+        pglGenQueries(DYNRES_QUERIES, queries);
+        telemetryCountGLCreate(DYNRES_QUERIES);
+    }
+    return true;
+}
+
+static void addSample(float seconds) {
+    if (seconds > MAX_FRAME_TIME) // Stalls say nothing about the scene, and some drivers get the first query wrong
+        seconds = MAX_FRAME_TIME;
+    average = average ? average + DYNRES_SMOOTHING * (seconds - average) : seconds;
+
+    // Fill cost goes with the number of pixels, that is with the square of the scale
+    float wanted = scale * sqrtf(DYNRES_HEADROOM * budget / average);
+    if (wanted > 1.0f - DYNRES_DEADBAND)
+        wanted = 1.0f;
+    if (wanted < DYNRES_MIN_SCALE)
+        wanted = DYNRES_MIN_SCALE;
+
+    if (fabsf(wanted - scale) >= DYNRES_DEADBAND || (wanted == 1.0f && scale != 1.0f))
+        scale = wanted;
+}
+
+// Results come in order, read whatever the GPU has finished without waiting for the rest
+static void collectSamples() {
+    if (!glHasTimerQueries) {
+        Uint64 counter = SDL_GetPerformanceCounter();
+        if (last_counter) {
+            float seconds = (float) (counter - last_counter) / SDL_GetPerformanceFrequency();
+            addSample(seconds);
+        }
+        last_counter = counter;
+        return;
+    }
+
+    while (pending_queries) {
+        GLuint query = queries[(next_query + DYNRES_QUERIES - pending_queries) % DYNRES_QUERIES];
+        GLint available = 0;
+        pglGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 nanoseconds = 0;
+        pglGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        pending_queries--;
+        addSample(nanoseconds * 1e-9f);
+    }
+}
+
+static bool resizeTarget(GLint width, GLint height) {
+    if (width == target_width && height == target_height)
+        return true;
+
+    if (!framebuffer) {
+        pglGenFramebuffers(1, &framebuffer);
+        pglGenRenderbuffers(1, &color_buffer);
+        pglGenRenderbuffers(1, &depth_buffer);
+        telemetryCountGLCreate(3);
+    }
+
+    pglBindRenderbuffer(GL_RENDERBUFFER, color_buffer);
+    pglRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    pglBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+    pglRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    pglBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer);
+    pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
+    bool complete = pglCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // Sized to the window rather than to the scene, so changing the scale never reallocates
+    target_width = complete ? width : 0;
+    target_height = complete ? height : 0;
+    return complete;
+}
+
+void dynamicResolutionBegin() {
+    if (!enabled)
+        return;
+
+    collectSamples();
+
+    glGetIntegerv(GL_VIEWPORT, window_viewport);
+    scene_width = (GLint) (window_viewport[2] * scale + 0.5f);
+    scene_height = (GLint) (window_viewport[3] * scale + 0.5f);
+    if (scene_width < 1)
+        scene_width = 1;
+    if (scene_height < 1)
+        scene_height = 1;
+
+    // Always offscreen, even at full scale, so the cost measured is the same kind of cost throughout
+    // (some drivers only rasterize a window frame at the swap, outside the timer query)
+    offscreen = resizeTarget(window_viewport[2], window_viewport[3]);
+    if (offscreen) {
+        pglBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, scene_width, scene_height);
+    }
+
+    timing = glHasTimerQueries && pending_queries < DYNRES_QUERIES; // Otherwise the GPU is too far behind to care
+    if (timing)
+        pglBeginQuery(GL_TIME_ELAPSED, queries[next_query]);
+}
+
+void dynamicResolutionEnd() {
+    if (!enabled)
+        return;
+
+    if (offscreen) {
+        pglBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        pglBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+        pglBlitFramebuffer(0, 0, scene_width, scene_height,
+                           window_viewport[0], window_viewport[1],
+                           window_viewport[0] + window_viewport[2], window_viewport[1] + window_viewport[3],
+                           GL_COLOR_BUFFER_BIT, GL_LINEAR);
+        pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(window_viewport[0], window_viewport[1], window_viewport[2], window_viewport[3]);
+        glClear(GL_DEPTH_BUFFER_BIT); // Window's depth is stale, it must not hide the HUD
+    }
+
+    if (timing) {
+        pglEndQuery(GL_TIME_ELAPSED);
+        next_query = (next_query + 1) % DYNRES_QUERIES;
+        pending_queries++;
+        timing = false;
+    }
+}
+
+float dynamicResolutionScale() {
+    return scale;
+}
+
+void dynamicResolutionFree() {
+    if (framebuffer) {
+        pglDeleteFramebuffers(1, &framebuffer);
+        pglDeleteRenderbuffers(1, &color_buffer);
+        pglDeleteRenderbuffers(1, &depth_buffer);
+        telemetryCountGLDelete(3);
+    }
+    framebuffer = color_buffer = depth_buffer = 0;
+    target_width = target_height = 0;
+
+    if (enabled && glHasTimerQueries) {
+        pglDeleteQueries(DYNRES_QUERIES, queries);
+        telemetryCountGLDelete(DYNRES_QUERIES);
+    }
+    enabled = false;
+    pending_queries = 0;
+}
@@ -0,0 +1,31 @@
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#define DYNRES_MIN_SCALE 0.35f  // Of the window size, on each axis
+#define DYNRES_HEADROOM 0.85f   // Aim this far below the budget, frame times are noisy
+#define DYNRES_SMOOTHING 0.2f   // Weight of the newest frame time in the running average
+#define DYNRES_DEADBAND 0.02f   // Smaller scale changes are not worth the shimmer
+#define DYNRES_QUERIES 4        // Timer queries in flight, results are read this many frames late
+
+/*
+ * Dynamic resolution: the 3D scene is drawn into the lower left part of an
+ * offscreen framebuffer of the window size, then stretched over the window,
+ * and the HUD and labels are drawn on top at full resolution. The part used
+ * shrinks when the scene takes longer than the budget and grows back when
+ * there is room, so frames stay on time at the cost of sharpness.
+ *
+ * Scene cost is measured on the GPU with timer queries, or as the whole frame
+ * time where they are missing (which with VSync never drops below the refresh
+ * interval, so the budget has to be longer than that).
+ *
+ * Begin/end wrap drawScene(), with the window's viewport set. Does nothing
+ * without framebuffer objects.
+ */
+bool dynamicResolutionInit(float budget_ms);
+void dynamicResolutionBegin();
+void dynamicResolutionEnd();
+float dynamicResolutionScale();
+void dynamicResolutionFree();
+
+#endif
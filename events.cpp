@@ -0,0 +1,315 @@
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "constants.h"
+#include "events.h"
+#include "thread_pool.h"
+
+struct EventBody {
+    const Planet *planet; // NULL for the Sun
+    const char *name;
+    double radius;
+    int parent;           // Body whose center the orbit is around, -1 for the Sun and planets
+    int system;           // Sun or the planet a moon belongs to
+    GLfloat frame[16];    // Orbital plane rotation, see Planet::orbitFrame()
+};
+
+struct EventPair {
+    int observer, a, b;
+    bool conjunctions;    // Only between different systems, moons are always next to their planet
+};
+
+/*
+ * Positions are relative to the Sun. Orbital planes do not move with time,
+ * so only the in-plane position has to be worked out for each sample.
+ */
+static void bodyPosition(const std::vector<EventBody> &bodies, int index, double t, double pos[3]) {
+    const EventBody &body = bodies[index];
+    if (!body.planet) {
+        pos[0] = pos[1] = pos[2] = 0.0;
+        return;
+    }
+
+    if (body.parent >= 0)
+        bodyPosition(bodies, body.parent, t, pos);
+    else
+        pos[0] = pos[1] = pos[2] = 0.0;
+
+    double x, z;
+    body.planet->orbitPosition(t, x, z);
+
+    const GLfloat *m = body.frame;
+    pos[0] += m[0] * x + m[8] * z;
+    pos[1] += m[1] * x + m[9] * z;
+    pos[2] += m[2] * x + m[10] * z;
+}
+
+struct Apparent {
+    double gap;        // Between the disks, negative when they overlap, radians
+    double separation; // Between the centers, radians
+    bool a_in_front;
+    bool a_is_smaller;
+};
+
+static Apparent apparent(const EventBody &a, const EventBody &b, const double o[3], const double pa[3], const double pb[3]) {
+    double u[3] = {pa[0] - o[0], pa[1] - o[1], pa[2] - o[2]};
+    double v[3] = {pb[0] - o[0], pb[1] - o[1], pb[2] - o[2]};
+
+    double cross[3] = {u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0]};
+    double du = sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+    double dv = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+    // atan2 keeps full precision at tiny angles, where acos of the dot product does not
+    Apparent result;
+    result.separation = atan2(sqrt(cross[0] * cross[0] + cross[1] * cross[1] + cross[2] * cross[2]),
+                              u[0] * v[0] + u[1] * v[1] + u[2] * v[2]);
+    double ra = asin(fmin(1.0, a.radius / du));
+    double rb = asin(fmin(1.0, b.radius / dv));
+    result.gap = result.separation - ra - rb;
+    result.a_in_front = du < dv;
+    result.a_is_smaller = ra < rb;
+
+    return result;
+}
+
+static Apparent apparentAt(const std::vector<EventBody> &bodies, const EventPair &pair, double t) {
+    double o[3], pa[3], pb[3];
+    bodyPosition(bodies, pair.observer, t, o);
+    bodyPosition(bodies, pair.a, t, pa);
+    bodyPosition(bodies, pair.b, t, pb);
+
+    return apparent(bodies[pair.a], bodies[pair.b], o, pa, pb);
+}
+
+// Golden-section search for the minimum of the gap, which is unimodal inside a bracket
+static double closestApproach(const std::vector<EventBody> &bodies, const EventPair &pair, double a, double b) {
+    const double ratio = (sqrt(5.0) - 1.0) / 2.0;
+    double c = b - ratio * (b - a), d = a + ratio * (b - a);
+    double fc = apparentAt(bodies, pair, c).gap, fd = apparentAt(bodies, pair, d).gap;
+
+    while (b - a > EVENT_TIME_TOLERANCE) {
+        if (fc < fd) {
+            b = d;
+            d = c, fd = fc;
+            c = b - ratio * (b - a);
+            fc = apparentAt(bodies, pair, c).gap;
+        } else {
+            a = c;
+            c = d, fc = fd;
+            d = a + ratio * (b - a);
+            fd = apparentAt(bodies, pair, d).gap;
+        }
+    }
+
+    return (a + b) / 2;
+}
+
+/*
+ * Disks overlap at `inside`. Walks away from it by `step` until they do not,
+ * then bisects the last step. NAN if the contact is beyond `limit`.
+ */
+static double contact(const std::vector<EventBody> &bodies, const EventPair &pair, double inside, double step, double limit) {
+    double outside = inside;
+    do {
+        inside = outside;
+        outside += step;
+        if ((step > 0) ? outside > limit : outside < limit) {
+            outside = limit;
+            if (apparentAt(bodies, pair, outside).gap < 0.0)
+                return NAN;
+            break;
+        }
+    } while (apparentAt(bodies, pair, outside).gap < 0.0);
+
+    while (fabs(outside - inside) > EVENT_TIME_TOLERANCE) {
+        double middle = (inside + outside) / 2;
+        if (apparentAt(bodies, pair, middle).gap < 0.0)
+            inside = middle;
+        else
+            outside = middle;
+    }
+
+    return (inside + outside) / 2;
+}
+
+static bool refine(const std::vector<EventBody> &bodies, const EventPair &pair, bool eclipse,
+                   double a, double b, double step, double from, double to, AstroEvent &event) {
+    double peak = closestApproach(bodies, pair, a, b);
+    Apparent at_peak = apparentAt(bodies, pair, peak);
+
+    event.peak = peak;
+    event.separation = at_peak.separation * 180.0 / M_PI;
+    event.front = bodies[at_peak.a_in_front ? pair.a : pair.b].name;
+    event.back = bodies[at_peak.a_in_front ? pair.b : pair.a].name;
+
+    if (at_peak.gap < 0.0) {
+        if (eclipse)
+            event.type = EVENT_ECLIPSE;
+        else
+            event.type = (at_peak.a_in_front == at_peak.a_is_smaller) ? EVENT_TRANSIT : EVENT_OCCULTATION;
+        event.begin = contact(bodies, pair, peak, -step, from);
+        event.end = contact(bodies, pair, peak, step, to);
+        return true;
+    }
+
+    if (pair.conjunctions && event.separation < EVENT_CONJUNCTION_LIMIT) {
+        event.type = EVENT_CONJUNCTION;
+        event.begin = event.end = NAN;
+        return true;
+    }
+
+    return false;
+}
+
+static void collectBodies(const std::vector<Planet> &planets, std::vector<EventBody> &bodies) {
+    EventBody sun;
+    memset(&sun, 0, sizeof(sun));
+    sun.name = "Sun";
+    sun.radius = SUN_RADIUS;
+    sun.parent = -1;
+    sun.system = 0;
+    bodies.push_back(sun);
+
+    for (auto it = planets.begin(); it != planets.end(); it++) {
+        EventBody planet;
+        planet.planet = &*it;
+        planet.name = it->getName();
+        planet.radius = it->getRadius();
+        planet.parent = -1;
+        planet.system = bodies.size();
+        it->orbitFrame(planet.frame);
+        bodies.push_back(planet);
+
+        // Translation of the parent frame is the parent's position, which bodyPosition() adds separately
+        int parent = bodies.size() - 1;
+        for (auto moon = it->getMoons().begin(); moon != it->getMoons().end(); moon++) {
+            EventBody body;
+            body.planet = &*moon;
+            body.name = moon->getName();
+            body.radius = moon->getRadius();
+            body.parent = parent;
+            body.system = parent;
+            moon->orbitFrame(body.frame, bodies[parent].frame);
+            bodies.push_back(body);
+        }
+    }
+}
+
+bool findEvents(const std::vector<Planet> &planets, double from, double to, const char *observer, std::vector<AstroEvent> &events) {
+    std::vector<EventBody> bodies;
+    collectBodies(planets, bodies);
+
+    int observer_index = -1;
+    for (size_t i = 0; i < bodies.size(); i++)
+        if (!strcmp(bodies[i].name, observer))
+            observer_index = i;
+    if (observer_index < 0) {
+        fprintf(stderr, "Unknown observer: %s\n", observer);
+        return false;
+    }
+
+    // Everything seen from the observer, then shadows within planetary systems seen from the Sun
+    std::vector<EventPair> pairs;
+    for (size_t a = 0; a < bodies.size(); a++)
+        for (size_t b = a + 1; b < bodies.size(); b++)
+            if ((int) a != observer_index && (int) b != observer_index) {
+                EventPair pair = {observer_index, (int) a, (int) b, bodies[a].system != bodies[b].system};
+                pairs.push_back(pair);
+            }
+    size_t eclipse_pairs = pairs.size();
+    if (observer_index != 0)
+        for (size_t a = 1; a < bodies.size(); a++)
+            for (size_t b = a + 1; b < bodies.size(); b++)
+                if (bodies[a].system == bodies[b].system) {
+                    EventPair pair = {0, (int) a, (int) b, false};
+                    pairs.push_back(pair);
+                }
+
+    // Both bodies of a pair move at most this fast, so no event can hide between two samples
+    double shortest = INFINITY;
+    for (size_t i = 1; i < bodies.size(); i++)
+        shortest = fmin(shortest, fabs(bodies[i].planet->getYear()));
+    double step = shortest / EVENT_SAMPLES_PER_ORBIT;
+    size_t samples = (size_t) ceil((to - from) / step) + 1;
+
+    double conjunction_limit = EVENT_CONJUNCTION_LIMIT * M_PI / 180.0;
+
+    size_t chunks = (samples + EVENT_SCAN_GRAIN - 1) / EVENT_SCAN_GRAIN;
+    std::vector<std::vector<AstroEvent> > found(chunks);
+
+    threadPool().parallelFor(samples, EVENT_SCAN_GRAIN, [&](size_t begin, size_t end) {
+        std::vector<double> positions(3 * bodies.size());
+        std::vector<double> gaps[3]; // Previous, current and next sample
+        for (int i = 0; i < 3; i++)
+            gaps[i].resize(pairs.size());
+
+        auto sample = [&](size_t k, std::vector<double> &gap) {
+            double t = fmin(from + k * step, to);
+            for (size_t i = 0; i < bodies.size(); i++)
+                bodyPosition(bodies, i, t, &positions[3 * i]);
+            for (size_t i = 0; i < pairs.size(); i++) {
+                const EventPair &pair = pairs[i];
+                gap[i] = apparent(bodies[pair.a], bodies[pair.b], &positions[3 * pair.observer],
+                                  &positions[3 * pair.a], &positions[3 * pair.b]).gap;
+            }
+        };
+
+        // A minimum at sample k needs both neighbours, ends of the range never qualify
+        size_t first = begin ? begin : 1;
+        if (first >= end || first + 1 >= samples)
+            return;
+        sample(first - 1, gaps[0]);
+        sample(first, gaps[1]);
+
+        std::vector<AstroEvent> &chunk_events = found[begin / EVENT_SCAN_GRAIN];
+        for (size_t k = first; k < end && k + 1 < samples; k++) {
+            sample(k + 1, gaps[2]);
+
+            for (size_t i = 0; i < pairs.size(); i++) {
+                if (!(gaps[0][i] > gaps[1][i] && gaps[1][i] <= gaps[2][i]))
+                    continue;
+
+                // The dip between samples is no deeper than the rise to the higher neighbour, skip hopeless ones
+                double lowest = 2 * gaps[1][i] - fmax(gaps[0][i], gaps[2][i]);
+                if (lowest > (pairs[i].conjunctions ? conjunction_limit : 0.0))
+                    continue;
+
+                AstroEvent event;
+                double a = from + (k - 1) * step, b = fmin(from + (k + 1) * step, to);
+                if (refine(bodies, pairs[i], i >= eclipse_pairs, a, b, step, from, to, event))
+                    chunk_events.push_back(event);
+            }
+
+            gaps[0].swap(gaps[1]);
+            gaps[1].swap(gaps[2]);
+        }
+    });
+
+    events.clear();
+    for (auto it = found.begin(); it != found.end(); it++)
+        events.insert(events.end(), it->begin(), it->end());
+    std::sort(events.begin(), events.end(), [](const AstroEvent &a, const AstroEvent &b) { return a.peak < b.peak; });
+
+    return true;
+}
+
+void printEvents(FILE *out, const std::vector<AstroEvent> &events) {
+    static const char *type_names[] = {"conjunction", "transit", "occultation", "eclipse"};
+
+    fprintf(out, "%14s %-12s %-10s %-10s %14s %14s %12s\n", "peak", "type", "front", "back", "begin", "end", "separation");
+    for (auto it = events.begin(); it != events.end(); it++) {
+        fprintf(out, "%14.6f %-12s %-10s %-10s ", it->peak, type_names[it->type], it->front, it->back);
+        if (it->type == EVENT_CONJUNCTION)
+            fprintf(out, "%14s %14s ", "-", "-");
+        else
+            fprintf(out, "%14.6f %14.6f ", it->begin, it->end);
+        fprintf(out, "%12.6f\n", it->separation);
+    }
+}
@@ -0,0 +1,46 @@
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdio.h>
+
+#include <vector>
+
+#include "planet.h"
+
+#define EVENT_SAMPLES_PER_ORBIT 64    // Scan step is the shortest orbital period divided by this
+#define EVENT_SCAN_GRAIN 4096         // Samples per parallel chunk
+#define EVENT_TIME_TOLERANCE 1e-6     // Refined event times are this precise, days (~0.1 s)
+#define EVENT_CONJUNCTION_LIMIT 1.0   // Closest approaches wider than this are not conjunctions, degrees
+
+enum EventType {
+    EVENT_CONJUNCTION, // Closest apparent approach of bodies from different planetary systems
+    EVENT_TRANSIT,     // Front body is seen crossing the (bigger) disk of the other one
+    EVENT_OCCULTATION, // Front body hides the (smaller) other one
+    EVENT_ECLIPSE      // Front body's shadow falls on the other one, found as an occultation seen from the Sun
+};
+
+struct AstroEvent {
+    EventType type;
+    double peak;             // Closest approach, days
+    double begin, end;       // First and last contact, days. NAN for conjunctions and contacts outside the range
+    double separation;       // Between centers at peak, degrees
+    const char *front, *back; // Nearer and farther body, as seen by the observer (the Sun for eclipses)
+};
+
+/*
+ * Searches [from, to] (days) for events seen from the center of `observer`
+ * (a body name, e.g. "Earth"), plus eclipses within planetary systems.
+ *
+ * Every pair of bodies is sampled on a common time grid fine enough to
+ * resolve the fastest orbit, chunks of the grid are scanned on all cores,
+ * and every local minimum of the gap between the disks brackets a
+ * candidate. Candidates are refined with golden-section search for the
+ * closest approach and bisection for contact times. Events come out sorted
+ * by peak time. Returns false if there is no such observer.
+ */
+bool findEvents(const std::vector<Planet> &planets, double from, double to, const char *observer, std::vector<AstroEvent> &events);
+
+void printEvents(FILE *out, const std::vector<AstroEvent> &events);
+
+#endif
@@ -0,0 +1,99 @@
+#include <stdio.h>
+
+#include <SDL.h>
+
+#include "gl_extensions.h"
+
+PFNGLGENFRAMEBUFFERSPROC pglGenFramebuffers = NULL;
+PFNGLDELETEFRAMEBUFFERSPROC pglDeleteFramebuffers = NULL;
+PFNGLBINDFRAMEBUFFERPROC pglBindFramebuffer = NULL;
+PFNGLFRAMEBUFFERRENDERBUFFERPROC pglFramebufferRenderbuffer = NULL;
+PFNGLFRAMEBUFFERTEXTURE2DPROC pglFramebufferTexture2D = NULL;
+PFNGLCHECKFRAMEBUFFERSTATUSPROC pglCheckFramebufferStatus = NULL;
+PFNGLGENRENDERBUFFERSPROC pglGenRenderbuffers = NULL;
+PFNGLDELETERENDERBUFFERSPROC pglDeleteRenderbuffers = NULL;
+PFNGLBINDRENDERBUFFERPROC pglBindRenderbuffer = NULL;
+PFNGLRENDERBUFFERSTORAGEPROC pglRenderbufferStorage = NULL;
+PFNGLBLITFRAMEBUFFERPROC pglBlitFramebuffer = NULL;
+
+PFNGLGENBUFFERSPROC pglGenBuffers = NULL;
+PFNGLDELETEBUFFERSPROC pglDeleteBuffers = NULL;
+PFNGLBINDBUFFERPROC pglBindBuffer = NULL;
+PFNGLBUFFERDATAPROC pglBufferData = NULL;
+PFNGLMAPBUFFERPROC pglMapBuffer = NULL;
+PFNGLUNMAPBUFFERPROC pglUnmapBuffer = NULL;
+PFNGLBUFFERSUBDATAPROC pglBufferSubData = NULL;
+
+PFNGLMULTIDRAWELEMENTSPROC pglMultiDrawElements = NULL;
+
+PFNGLBUFFERSTORAGEPROC pglBufferStorage = NULL;
+PFNGLMAPBUFFERRANGEPROC pglMapBufferRange = NULL;
+PFNGLFENCESYNCPROC pglFenceSync = NULL;
+PFNGLCLIENTWAITSYNCPROC pglClientWaitSync = NULL;
+PFNGLDELETESYNCPROC pglDeleteSync = NULL;
+
+PFNGLGENQUERIESPROC pglGenQueries = NULL;
+PFNGLDELETEQUERIESPROC pglDeleteQueries = NULL;
+PFNGLBEGINQUERYPROC pglBeginQuery = NULL;
+PFNGLENDQUERYPROC pglEndQuery = NULL;
+PFNGLGETQUERYOBJECTIVPROC pglGetQueryObjectiv = NULL;
+PFNGLGETQUERYOBJECTUI64VPROC pglGetQueryObjectui64v = NULL;
+
+bool glHasFramebuffers = false, glHasBuffers = false, glHasPixelBuffers = false;
+bool glHasMultiDraw = false, glHasBufferStorage = false, glHasTimerQueries = false;
+
+#define LOAD(name, type) (p##name = (type) SDL_GL_GetProcAddress(#name))
+
+void loadGLExtensions() {
+    int major = 1, minor = 0;
+    const char *version = (const char*) glGetString(GL_VERSION);
+    if (version)
+        sscanf(version, "%d.%d", &major, &minor);
+
+    // Non-NULL is not a proof of support on some platforms, so check the version too
+    if (major >= 3 || SDL_GL_ExtensionSupported("GL_ARB_framebuffer_object"))
+        glHasFramebuffers = LOAD(glGenFramebuffers, PFNGLGENFRAMEBUFFERSPROC) &&
+                            LOAD(glDeleteFramebuffers, PFNGLDELETEFRAMEBUFFERSPROC) &&
+                            LOAD(glBindFramebuffer, PFNGLBINDFRAMEBUFFERPROC) &&
+                            LOAD(glFramebufferRenderbuffer, PFNGLFRAMEBUFFERRENDERBUFFERPROC) &&
+                            LOAD(glFramebufferTexture2D, PFNGLFRAMEBUFFERTEXTURE2DPROC) &&
+                            LOAD(glCheckFramebufferStatus, PFNGLCHECKFRAMEBUFFERSTATUSPROC) &&
+                            LOAD(glGenRenderbuffers, PFNGLGENRENDERBUFFERSPROC) &&
+                            LOAD(glDeleteRenderbuffers, PFNGLDELETERENDERBUFFERSPROC) &&
+                            LOAD(glBindRenderbuffer, PFNGLBINDRENDERBUFFERPROC) &&
+                            LOAD(glRenderbufferStorage, PFNGLRENDERBUFFERSTORAGEPROC) &&
+                            LOAD(glBlitFramebuffer, PFNGLBLITFRAMEBUFFERPROC);
+
+    if (major > 1 || minor >= 5 || SDL_GL_ExtensionSupported("GL_ARB_vertex_buffer_object"))
+        glHasBuffers = LOAD(glGenBuffers, PFNGLGENBUFFERSPROC) &&
+                       LOAD(glDeleteBuffers, PFNGLDELETEBUFFERSPROC) &&
+                       LOAD(glBindBuffer, PFNGLBINDBUFFERPROC) &&
+                       LOAD(glBufferData, PFNGLBUFFERDATAPROC) &&
+                       LOAD(glMapBuffer, PFNGLMAPBUFFERPROC) &&
+                       LOAD(glUnmapBuffer, PFNGLUNMAPBUFFERPROC) &&
+                       LOAD(glBufferSubData, PFNGLBUFFERSUBDATAPROC);
+
+    glHasPixelBuffers = glHasBuffers &&
+        (major > 2 || (major == 2 && minor >= 1) || SDL_GL_ExtensionSupported("GL_ARB_pixel_buffer_object"));
+
+    if (major > 1 || minor >= 4)
+        glHasMultiDraw = LOAD(glMultiDrawElements, PFNGLMULTIDRAWELEMENTSPROC);
+
+    bool storage = major > 4 || (major == 4 && minor >= 4) || SDL_GL_ExtensionSupported("GL_ARB_buffer_storage");
+    bool sync = major > 3 || (major == 3 && minor >= 2) || SDL_GL_ExtensionSupported("GL_ARB_sync");
+    bool map_range = major >= 3 || SDL_GL_ExtensionSupported("GL_ARB_map_buffer_range");
+    if (glHasBuffers && storage && sync && map_range)
+        glHasBufferStorage = LOAD(glBufferStorage, PFNGLBUFFERSTORAGEPROC) &&
+                             LOAD(glMapBufferRange, PFNGLMAPBUFFERRANGEPROC) &&
+                             LOAD(glFenceSync, PFNGLFENCESYNCPROC) &&
+                             LOAD(glClientWaitSync, PFNGLCLIENTWAITSYNCPROC) &&
+                             LOAD(glDeleteSync, PFNGLDELETESYNCPROC);
+
+    if (major > 3 || (major == 3 && minor >= 3) || SDL_GL_ExtensionSupported("GL_ARB_timer_query"))
+        glHasTimerQueries = LOAD(glGenQueries, PFNGLGENQUERIESPROC) &&
+                            LOAD(glDeleteQueries, PFNGLDELETEQUERIESPROC) &&
+                            LOAD(glBeginQuery, PFNGLBEGINQUERYPROC) &&
+                            LOAD(glEndQuery, PFNGLENDQUERYPROC) &&
+                            LOAD(glGetQueryObjectiv, PFNGLGETQUERYOBJECTIVPROC) &&
+                            LOAD(glGetQueryObjectui64v, PFNGLGETQUERYOBJECTUI64VPROC);
+}
@@ -0,0 +1,65 @@
+
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+
+#include <SDL_opengl.h>
+
+/*
+ * Entry points newer than OpenGL 1.1 are not exported by opengl32.dll and
+ * not guaranteed to be by libGL either, so they are looked up at runtime
+ * through SDL once a context exists. Each group is usable only when the
+ * matching flag is set after loadGLExtensions().
+ */
+
+// Framebuffer objects (GL 3.0 or ARB_framebuffer_object)
+extern PFNGLGENFRAMEBUFFERSPROC pglGenFramebuffers;
+extern PFNGLDELETEFRAMEBUFFERSPROC pglDeleteFramebuffers;
+extern PFNGLBINDFRAMEBUFFERPROC pglBindFramebuffer;
+extern PFNGLFRAMEBUFFERRENDERBUFFERPROC pglFramebufferRenderbuffer;
+extern PFNGLFRAMEBUFFERTEXTURE2DPROC pglFramebufferTexture2D;
+extern PFNGLCHECKFRAMEBUFFERSTATUSPROC pglCheckFramebufferStatus;
+extern PFNGLGENRENDERBUFFERSPROC pglGenRenderbuffers;
+extern PFNGLDELETERENDERBUFFERSPROC pglDeleteRenderbuffers;
+extern PFNGLBINDRENDERBUFFERPROC pglBindRenderbuffer;
+extern PFNGLRENDERBUFFERSTORAGEPROC pglRenderbufferStorage;
+extern PFNGLBLITFRAMEBUFFERPROC pglBlitFramebuffer;
+
+// Buffer objects (GL 1.5)
+extern PFNGLGENBUFFERSPROC pglGenBuffers;
+extern PFNGLDELETEBUFFERSPROC pglDeleteBuffers;
+extern PFNGLBINDBUFFERPROC pglBindBuffer;
+extern PFNGLBUFFERDATAPROC pglBufferData;
+extern PFNGLMAPBUFFERPROC pglMapBuffer;
+extern PFNGLUNMAPBUFFERPROC pglUnmapBuffer;
+extern PFNGLBUFFERSUBDATAPROC pglBufferSubData;
+
+// Drawing several index ranges in one call (GL 1.4)
+extern PFNGLMULTIDRAWELEMENTSPROC pglMultiDrawElements;
+
+// Persistently mapped buffers (GL 4.4 or ARB_buffer_storage) and fences to write into them safely
+extern PFNGLBUFFERSTORAGEPROC pglBufferStorage;
+extern PFNGLMAPBUFFERRANGEPROC pglMapBufferRange;
+extern PFNGLFENCESYNCPROC pglFenceSync;
+extern PFNGLCLIENTWAITSYNCPROC pglClientWaitSync;
+extern PFNGLDELETESYNCPROC pglDeleteSync;
+
+// Timing GPU work (GL 3.3 or ARB_timer_query)
+extern PFNGLGENQUERIESPROC pglGenQueries;
+extern PFNGLDELETEQUERIESPROC pglDeleteQueries;
+extern PFNGLBEGINQUERYPROC pglBeginQuery;
+extern PFNGLENDQUERYPROC pglEndQuery;
+extern PFNGLGETQUERYOBJECTIVPROC pglGetQueryObjectiv;
+extern PFNGLGETQUERYOBJECTUI64VPROC pglGetQueryObjectui64v;
+
+extern bool glHasFramebuffers, glHasBuffers;
+extern bool glHasPixelBuffers; // Buffer objects as glReadPixels() targets (GL 2.1)
+extern bool glHasMultiDraw, glHasBufferStorage, glHasTimerQueries;
+
+void loadGLExtensions(); // Needs a current context
+
+#endif
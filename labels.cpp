@@ -0,0 +1,62 @@
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include "labels.h"
+
+static std::vector<std::vector<size_t> > cells; // Reused between frames to avoid reallocation
+static std::vector<Label> accepted;
+
+static bool higherPriority(const Label &a, const Label &b) {
+    return a.priority > b.priority;
+}
+
+static bool overlap(const Label &a, const Label &b) {
+    return abs(a.x - b.x) * 2 < a.w + b.w + 2 * LABEL_PADDING &&
+           abs(a.y - b.y) * 2 < a.h + b.h + 2 * LABEL_PADDING;
+}
+
+void declutterLabels(std::vector<Label> &labels, GLint width, GLint height) {
+    std::stable_sort(labels.begin(), labels.end(), higherPriority);
+
+    GLint columns = width / LABEL_CELL_SIZE + 1, rows = height / LABEL_CELL_SIZE + 1;
+    if (cells.size() < (size_t) (columns * rows))
+        cells.resize(columns * rows);
+    for (auto it = cells.begin(); it != cells.end(); it++)
+        it->clear();
+    accepted.clear();
+
+    for (auto label = labels.begin(); label != labels.end(); label++) {
+        GLint left = label->x - label->w / 2, right = label->x + label->w / 2;
+        GLint bottom = label->y - label->h / 2, top = label->y + label->h / 2;
+        if (right < 0 || left >= width || top < 0 || bottom >= height)
+            continue;
+
+        // Padding is included, so neighbours that are too close share a cell with us
+        GLint col0 = std::max((left - LABEL_PADDING) / LABEL_CELL_SIZE, 0);
+        GLint col1 = std::min((right + LABEL_PADDING) / LABEL_CELL_SIZE, columns - 1);
+        GLint row0 = std::max((bottom - LABEL_PADDING) / LABEL_CELL_SIZE, 0);
+        GLint row1 = std::min((top + LABEL_PADDING) / LABEL_CELL_SIZE, rows - 1);
+
+        bool collides = false;
+        for (GLint row = row0; row <= row1 && !collides; row++)
+            for (GLint col = col0; col <= col1 && !collides; col++) {
+                const std::vector<size_t> &cell = cells[row * columns + col];
+                for (auto it = cell.begin(); it != cell.end(); it++)
+                    if (overlap(*label, accepted[*it])) {
+                        collides = true;
+                        break;
+                    }
+            }
+
+        if (collides)
+            continue;
+
+        for (GLint row = row0; row <= row1; row++)
+            for (GLint col = col0; col <= col1; col++)
+                cells[row * columns + col].push_back(accepted.size());
+        accepted.push_back(*label);
+    }
+
+    labels.swap(accepted);
+}
@@ -0,0 +1,32 @@
+
+#ifndef LABELS_H
+#define LABELS_H
+
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+#include <vector>
+
+#define LABEL_CELL_SIZE 64 // Side of a screen-space hash cell, pixels
+#define LABEL_PADDING 2    // Minimal gap between two labels, pixels
+
+struct Label {
+    const char *text;
+    GLint x, y;        // Center, OpenGL window coordinates
+    GLint w, h;        // Size of rendered text
+    GLfloat priority;  // Bigger wins
+};
+
+/*
+ * Drops labels that are off the screen or overlap a more important one.
+ * Labels are placed in order of priority and every accepted rectangle is
+ * binned into a grid of LABEL_CELL_SIZE cells, so each test only looks at
+ * labels in the same few cells. What is left is bounded by the screen area,
+ * not by the number of bodies, and that is all that gets rendered as text.
+ */
+void declutterLabels(std::vector<Label> &labels, GLint width, GLint height);
+
+#endif
@@ -5,6 +5,9 @@
 #include <windows.h>
 #endif
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <SDL.h>
 #include <SDL_opengl.h>
@@ -16,13 +19,23 @@
 
 #include "constants.h"
 #include "rendering.h"
-#include "bmp_loader.h"
 #include "planet.h"
+#include "shm_export.h"
+#include "mpc_import.h"
+#include "telemetry.h"
+#include "gl_extensions.h"
+#include "render_server.h"
+#include "events.h"
+#include "scene_generator.h"
+#include "texture_manager.h"
+#include "snapshot.h"
+#include "dynamic_resolution.h"
+#include "dome.h"
 
 static GLfloat xpos = 0.0f, ypos = ASTRONOMIC_UNIT * 1.0f, zpos = ASTRONOMIC_UNIT * 2.5f;
 static GLfloat sight_x = 0.0f, sight_y = -0.43f, sight_z = -0.9f;
 static GLfloat up_x = 0.0f, up_y = 1.0f, up_z = 0.0f;
-static bool orbits = false, running = true, vsync = true, help = false;
+static bool orbits = false, running = true, vsync = true, help = false, nbody_mode = false, telemetry = false, trails = false;
 static Uint32 last_time = 0, frames = 0;
 static SDL_Window *window = NULL;
 static TTF_Font *font = NULL;
@@ -62,39 +75,107 @@ void translate_in_camera_basis(const GLfloat dx, const GLfloat dy, const GLfloat
 }
 
 void renderScene(void) {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glLoadIdentity();
+    TelemetryScope scope(TELEMETRY_SCENE);
+
+    GLfloat camera[9] = {xpos, ypos, zpos, sight_x, sight_y, sight_z, up_x, up_y, up_z};
+    bool dome = domeEnabled() && domeRender(camera, orbits, nbody_mode, trails);
+    if (!dome) {
+        dynamicResolutionBegin();
+        drawScene(camera, orbits, nbody_mode, trails);
+        dynamicResolutionEnd();
+    }
+    if (font) {
+        TelemetryScope hud_scope(TELEMETRY_HUD);
+        drawStats(font, 1000 * frames / SDL_GetTicks(), help, telemetry, !dome);
+    }
 
-    gluLookAt(xpos,           ypos,           zpos,
-              xpos + sight_x, ypos + sight_y, zpos + sight_z,
-              up_x,           up_y,           up_z);
+    SDL_GL_SwapWindow(window);
+}
 
-    GLfloat sun_p[] = {0.0f, 0.0f, 0.0f, 1.0f};
-    glLightfv(GL_LIGHT0, GL_POSITION, sun_p);
+static SnapshotState currentState() {
+    SnapshotState state = {days, {xpos, ypos, zpos, sight_x, sight_y, sight_z, up_x, up_y, up_z}, orbits, nbody_mode, trails, speed_factor};
+    return state;
+}
 
-    //drawAxes();
-    drawSky();
+static void restoreState(const SnapshotState &state) {
+    setSimulationTime(state.days);
+    xpos = state.camera[0]; ypos = state.camera[1]; zpos = state.camera[2];
+    sight_x = state.camera[3]; sight_y = state.camera[4]; sight_z = state.camera[5];
+    up_x = state.camera[6]; up_y = state.camera[7]; up_z = state.camera[8];
+    orbits = state.orbits;
+    nbody_mode = state.nbody_mode;
+    trails = state.trails;
+    speed_factor = state.speed_factor;
+}
 
-    drawSun();
-    drawPlanets(orbits);
-    if (font)
-        drawStats(font, 1000 * frames / SDL_GetTicks(), help);
+void reshape(int w, int h) {
+    setPerspective(w, h);
+}
 
-    SDL_GL_SwapWindow(window);
+// First rotation is easy, because it does not change the up vector
+void rotate_yaw(GLfloat angle) {
+    translate_in_camera_basis(cosf(angle), 0.0f, sinf(angle), sight_x, sight_y, sight_z);
 }
 
-void reshape(int w, int h) {
-    if (!h)
-        h = 1;
+// Here we need to recalculate up vector as [side x sight]
+void rotate_pitch(GLfloat angle) {
+    GLfloat side_x, side_y, side_z;
+    cross_product(sight_x, sight_y, sight_z, up_x, up_y, up_z, side_x, side_y, side_z);
+    translate_in_camera_basis(cosf(angle), sinf(angle), 0.0f, sight_x, sight_y, sight_z);
+    cross_product(side_x, side_y, side_z, sight_x, sight_y, sight_z, up_x, up_y, up_z);
+    normalize_vector(sight_x, sight_y, sight_z);
+}
 
-    glViewport(0, 0, (GLint) w, (GLint) h);
+// Does not change the sight vector
+void rotate_roll(GLfloat angle) {
+    translate_in_camera_basis(0.0f, cosf(angle), sinf(angle), up_x, up_y, up_z);
+}
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
+/*
+ * Camera movement samples keyboard state once per frame instead of reacting
+ * to key events, so it starts on the very next frame, does not depend on key
+ * repeat settings and moves with the same speed at any frame rate.
+ */
+void updateCamera(GLfloat seconds) {
+    const Uint8 *keys = SDL_GetKeyboardState(NULL);
+
+    // Velocity in camera basis: along sight, up and side vectors
+    GLfloat forward = keys[SDL_SCANCODE_W] - keys[SDL_SCANCODE_S];
+    GLfloat upward = keys[SDL_SCANCODE_Z] - keys[SDL_SCANCODE_X];
+    GLfloat sideways = keys[SDL_SCANCODE_D] - keys[SDL_SCANCODE_A];
+
+    if (forward || upward || sideways) {
+        GLfloat side_x, side_y, side_z;
+        cross_product(sight_x, sight_y, sight_z, up_x, up_y, up_z, side_x, side_y, side_z);
+        normalize_vector(side_x, side_y, side_z);
+
+        GLfloat step = CAMERA_SPEED * speed_factor * seconds;
+        xpos += (sight_x * forward + up_x * upward + side_x * sideways) * step;
+        ypos += (sight_y * forward + up_y * upward + side_y * sideways) * step;
+        zpos += (sight_z * forward + up_z * upward + side_z * sideways) * step;
+    }
 
-    gluPerspective(45.0f, (float) w/h,  0.1f / ASTRONOMIC_UNIT, ASTRONOMIC_UNIT * 50.0f);
+    GLfloat yaw = keys[SDL_SCANCODE_RIGHT] - keys[SDL_SCANCODE_LEFT];
+    GLfloat pitch = keys[SDL_SCANCODE_UP] - keys[SDL_SCANCODE_DOWN];
+    GLfloat roll = keys[SDL_SCANCODE_PAGEDOWN] - keys[SDL_SCANCODE_PAGEUP];
+    yaw *= CAMERA_ANGULAR_SPEED * seconds;
+    pitch *= CAMERA_ANGULAR_SPEED * seconds;
+    roll *= CAMERA_ANGULAR_SPEED * seconds;
+
+    // Mouse-look while the right button is held, relative mode hides the cursor and never stops at the screen edge
+    int dx, dy;
+    Uint32 buttons = SDL_GetRelativeMouseState(&dx, &dy);
+    if (buttons & SDL_BUTTON_RMASK) {
+        yaw += dx * MOUSE_SENSITIVITY;
+        pitch -= dy * MOUSE_SENSITIVITY;
+    }
 
-    glMatrixMode(GL_MODELVIEW);
+    if (yaw)
+        rotate_yaw(yaw);
+    if (pitch)
+        rotate_pitch(pitch);
+    if (roll)
+        rotate_roll(roll);
 }
 
 void keyboard(SDL_Scancode key) {
@@ -106,40 +187,6 @@ void keyboard(SDL_Scancode key) {
         case SDL_SCANCODE_Q:
             running = false;
             break;
-        case SDL_SCANCODE_W:
-            xpos += sight_x * 0.008f * speed_factor;
-            ypos += sight_y * 0.008f * speed_factor;
-            zpos += sight_z * 0.008f * speed_factor;
-            break;
-        case SDL_SCANCODE_S:
-            xpos -= sight_x * 0.008f * speed_factor;
-            ypos -= sight_y * 0.008f * speed_factor;
-            zpos -= sight_z * 0.008f * speed_factor;
-            break;
-        case SDL_SCANCODE_A:
-            cross_product(up_x, up_y, up_z, sight_x, sight_y, sight_z, side_x, side_y, side_z);
-            normalize_vector(side_x, side_y, side_z);
-            xpos += side_x * 0.008f * speed_factor;
-            ypos += side_y * 0.008f * speed_factor;
-            zpos += side_z * 0.008f * speed_factor;
-            break;
-        case SDL_SCANCODE_D:
-            cross_product(sight_x, sight_y, sight_z, up_x, up_y, up_z, side_x, side_y, side_z);
-            normalize_vector(side_x, side_y, side_z);
-            xpos += side_x * 0.008f * speed_factor;
-            ypos += side_y * 0.008f * speed_factor;
-            zpos += side_z * 0.008f * speed_factor;
-            break;
-        case SDL_SCANCODE_Z:
-            xpos += up_x * 0.008f * speed_factor;
-            ypos += up_y * 0.008f * speed_factor;
-            zpos += up_z * 0.008f * speed_factor;
-            break;
-        case SDL_SCANCODE_X:
-            xpos -= up_x * 0.008f * speed_factor;
-            ypos -= up_y * 0.008f * speed_factor;
-            zpos -= up_z * 0.008f * speed_factor;
-            break;
         case SDL_SCANCODE_R:
             xpos = 0.0f, ypos = ASTRONOMIC_UNIT * 1.0f, zpos = ASTRONOMIC_UNIT * 2.5f;
             sight_x = 0.0f, sight_y = -0.43f, sight_z = -0.9f;
@@ -155,32 +202,13 @@ void keyboard(SDL_Scancode key) {
         case SDL_SCANCODE_O:
             orbits = !orbits;
             break;
-        // First two rotations are easy, because the do not change the up vector
-        case SDL_SCANCODE_LEFT:
-            translate_in_camera_basis(cosf(-0.02f), 0.0f, sinf(-0.02f), sight_x, sight_y, sight_z);
+        case SDL_SCANCODE_L:
+            trails = !trails;
             break;
-        case SDL_SCANCODE_RIGHT:
-            translate_in_camera_basis(cosf(0.02f), 0.0f, sinf(0.02f), sight_x, sight_y, sight_z);
-            break;
-        // In the second two rotations we need to recalculate up vector as [side x sight]
-        case SDL_SCANCODE_UP:
-            cross_product(sight_x, sight_y, sight_z, up_x, up_y, up_z, side_x, side_y, side_z);
-            translate_in_camera_basis(cosf(0.02f), sinf(0.02f), 0.0f, sight_x, sight_y, sight_z);
-            cross_product(side_x, side_y, side_z, sight_x, sight_y, sight_z, up_x, up_y, up_z);
-            normalize_vector(sight_x, sight_y, sight_z);
-            break;
-        case SDL_SCANCODE_DOWN:
-            cross_product(sight_x, sight_y, sight_z, up_x, up_y, up_z, side_x, side_y, side_z);
-            translate_in_camera_basis(cosf(-0.02f), sinf(-0.02f), 0.0f, sight_x, sight_y, sight_z);
-            cross_product(side_x, side_y, side_z, sight_x, sight_y, sight_z, up_x, up_y, up_z);
-            normalize_vector(sight_x, sight_y, sight_z);
-            break;
-        // Last two do not change the sight vector
-        case SDL_SCANCODE_PAGEUP:
-            translate_in_camera_basis(0.0f, cosf(-0.02f), sinf(-0.02f), up_x, up_y, up_z);
-            break;
-        case SDL_SCANCODE_PAGEDOWN:
-            translate_in_camera_basis(0.0f, cosf(0.02f), sinf(0.02f), up_x, up_y, up_z);
+        case SDL_SCANCODE_N:
+            nbody_mode = !nbody_mode;
+            if (nbody_mode) // Accelerations left from when it was turned off are against old planet positions
+                nbody.invalidateAccelerations();
             break;
         case SDL_SCANCODE_T:
             if (speed_factor == 100)
@@ -195,6 +223,9 @@ void keyboard(SDL_Scancode key) {
         case SDL_SCANCODE_H:
             help = !help;
             break;
+        case SDL_SCANCODE_M:
+            telemetry = !telemetry;
+            break;
         default:
             break;
     }
@@ -207,28 +238,118 @@ void mouse(Sint32 x, Sint32 y) {
     Sint32 y1 = 79;
     size_t i;
 
-    for (i = 0; i < planets.size(); i++) {
+    for (i = 0; i < buttonCount(); i++) {
         if (y > y1 && y < y1 + 50)
             break;
         y1 += 59;
     }
 
-    if (i == planets.size())
+    if (i == buttonCount())
         return;
 
     GLfloat side_x, side_y, side_z;
 
+    selectedPlanet = &planets[i];
     planets[i].generateLookAt(xpos, ypos, zpos, sight_x, sight_y, sight_z, up_x, up_y, up_z);
     cross_product(sight_x, sight_y, sight_z, up_x, up_y, up_z, side_x, side_y, side_z);
     cross_product(side_x, side_y, side_z, sight_x, sight_y, sight_z, up_x, up_y, up_z);
     normalize_vector(up_x, up_y, up_z);
 }
 
-int main(int, char **) {
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [options]\n"
+                    "  --shm NAME  publish simulation state to POSIX shared memory NAME, e.g. /solar\n"
+                    "  --mpc FILE  use orbits from MPCORB-format FILE as N-body particles instead of a random belt\n"
+                    "  --telemetry  print allocation and GL object statistics on exit\n"
+                    "  --zero-alloc-after N  fail (exit code 2) if any frame after the first N allocates memory\n"
+                    "  --frames N  quit after N frames\n"
+                    "  --server PATH  render snapshots on request from UNIX socket PATH instead of showing a window\n"
+                    "  --events FROM TO  list conjunctions, transits, occultations and eclipses between days FROM and TO, then quit\n"
+                    "  --observer NAME  body the events are seen from, Earth by default\n"
+                    "  --trail-days N  length of body trails, days\n"
+                    "  --generate SEED  replace the Solar system with a random one made from SEED\n"
+                    "  --planets N  planets in a generated system\n"
+                    "  --moons N  moons of every generated planet\n"
+                    "  --labels N  name only the first N generated bodies\n"
+                    "  --belt N  asteroid belt particles\n"
+                    "  --snapshot FILE  resume from FILE if it exists, save to it every few seconds and on exit\n"
+                    "  --frame-budget MS  lower the scene resolution as needed to draw it within MS milliseconds\n"
+                    "  --texture-budget MB  keep at most MB megabytes of textures on the GPU, reload evicted ones when needed\n"
+                    "  --dome fisheye|equirect  show the whole view around the camera, as a dome master or a panorama\n",
+            program);
+}
+
+int main(int argc, char *argv[]) {
+    const char *shm_name = NULL, *mpc_file = NULL, *server_path = NULL, *observer = "Earth", *snapshot_path = NULL;
+    bool find_events = false;
+    double events_from = 0.0, events_to = 0.0, trail_days = TRAIL_DAYS;
+    bool dump_telemetry = false;
+    unsigned long frame_limit = 0;
+    bool generate = false;
+    unsigned seed = 0;
+    double texture_budget = 0.0, frame_budget = 0.0;
+    const char *dome = NULL;
+    size_t planet_count = GENERATOR_PLANETS, moon_count = GENERATOR_MOONS, label_count = (size_t) -1, belt_count = NBODY_PARTICLES;
+
+    telemetryInit();
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--shm") && i + 1 < argc) {
+            shm_name = argv[++i];
+        } else if (!strcmp(argv[i], "--mpc") && i + 1 < argc) {
+            mpc_file = argv[++i];
+        } else if (!strcmp(argv[i], "--telemetry")) {
+            dump_telemetry = true;
+        } else if (!strcmp(argv[i], "--zero-alloc-after") && i + 1 < argc) {
+            telemetryExpectZeroAllocations(strtoul(argv[++i], NULL, 10));
+            dump_telemetry = true;
+        } else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            frame_limit = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--server") && i + 1 < argc) {
+            server_path = argv[++i];
+        } else if (!strcmp(argv[i], "--events") && i + 2 < argc) {
+            find_events = true;
+            events_from = atof(argv[++i]);
+            events_to = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--observer") && i + 1 < argc) {
+            observer = argv[++i];
+        } else if (!strcmp(argv[i], "--trail-days") && i + 1 < argc) {
+            trail_days = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--snapshot") && i + 1 < argc) {
+            snapshot_path = argv[++i];
+        } else if (!strcmp(argv[i], "--frame-budget") && i + 1 < argc) {
+            frame_budget = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--texture-budget") && i + 1 < argc) {
+            texture_budget = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--dome") && i + 1 < argc && (!strcmp(argv[i + 1], "fisheye") || !strcmp(argv[i + 1], "equirect"))) {
+            dome = argv[++i];
+        } else if (!strcmp(argv[i], "--generate") && i + 1 < argc) {
+            generate = true;
+            seed = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--planets") && i + 1 < argc) {
+            planet_count = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--moons") && i + 1 < argc) {
+            moon_count = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--labels") && i + 1 < argc) {
+            label_count = strtoul(argv[++i], NULL, 10);
+        } else if (!strcmp(argv[i], "--belt") && i + 1 < argc) {
+            belt_count = strtoul(argv[++i], NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (shm_name && !shmExportOpen(shm_name))
+        return 1;
+
     SDL_Init(SDL_INIT_EVERYTHING);
     TTF_Init();
-    window = SDL_CreateWindow("Solar system", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WIDTH, HEIGHT, SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE);
+    // Server renders offscreen and event search does not render at all, they only need a GL context for textures
+    Uint32 window_flags = (server_path || find_events) ? SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN : SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE;
+    window = SDL_CreateWindow("Solar system", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, WIDTH, HEIGHT, window_flags);
     SDL_GLContext glcontext = SDL_GL_CreateContext(window);
+    loadGLExtensions();
     SDL_GL_SetSwapInterval(vsync); // Enable VSYNC
     reshape(WIDTH, HEIGHT); // SDL does not send resize event on startup
 
@@ -248,19 +369,68 @@ int main(int, char **) {
 
     glClearDepth(1.0);
 
-    initPlanets();
+    // Dome output draws its own offscreen views, the frame budget is for the usual one
+    if (dome)
+        domeInit(strcmp(dome, "fisheye") ? DOME_EQUIRECTANGULAR : DOME_FISHEYE); // Usual view if it is not possible
+    else if (frame_budget > 0.0)
+        dynamicResolutionInit(frame_budget); // Full resolution if it is not possible
+
+    setTextureBudget(texture_budget * 1024 * 1024);
+
+    if (generate)
+        generatePlanets(planets, seed, planet_count, moon_count, label_count);
+    else
+        initPlanets();
+
+    int status = 0;
+
+    // Resumed particles replace whatever would have been seeded
+    SnapshotState snapshot;
+    if (snapshot_path && snapshotLoad(snapshot_path, snapshot, nbody, countBodies(planets), generate ? seed : 0)) {
+        restoreState(snapshot);
+        fprintf(stderr, "Resumed from %s at day %.2f\n", snapshot_path, days);
+    } else if (mpc_file) {
+        if (importMPCOrbits(mpc_file, nbody) < 0) {
+            status = 1;
+            running = false; // Planets hold textures, they must go through the cleanup below
+        }
+    } else {
+        nbody.seedBelt(belt_count, generate ? seed : 1);
+    }
+
+    initTrails(trail_days);
 
-    starsTexture = loadBMPTexture("textures/starmap.bmp");
-    sunTexture = loadBMPTexture("textures/sun.bmp");
+    starsTexture = acquireTexture("textures/starmap.bmp");
+    sunTexture = acquireTexture("textures/sun.bmp");
 
     last_time = SDL_GetTicks();
+    Uint32 last_checkpoint = last_time;
     Uint32 dt = 1000 / FPS, delta = 0;
+    Uint64 last_counter = SDL_GetPerformanceCounter();
 
     GLfloat side_x, side_y, side_z;
     cross_product(sight_x, sight_y, sight_z, up_x, up_y, up_z, side_x, side_y, side_z);
     cross_product(side_x, side_y, side_z, sight_x, sight_y, sight_z, up_x, up_y, up_z);
     normalize_vector(up_x, up_y, up_z);
 
+    if (!running) {
+        // Failed to start
+    } else if (find_events) {
+        std::vector<AstroEvent> events;
+        Uint64 start = SDL_GetPerformanceCounter();
+        if (findEvents(planets, events_from, events_to, observer, events)) {
+            printEvents(stdout, events);
+            fprintf(stderr, "%lu events found in %.3f s\n", (unsigned long) events.size(),
+                    (double) (SDL_GetPerformanceCounter() - start) / SDL_GetPerformanceFrequency());
+        } else {
+            status = 1;
+        }
+        running = false;
+    } else if (server_path) {
+        status = renderServerRun(server_path, font) ? 0 : 1;
+        running = false;
+    }
+
     while (running) {
         SDL_Event event;
         while (SDL_PollEvent(&event))
@@ -273,32 +443,81 @@ int main(int, char **) {
                         reshape(event.window.data1, event.window.data2);
                     break;
                 case SDL_KEYDOWN:
-                    keyboard(event.key.keysym.scancode);
+                    if (!event.key.repeat) // Toggles only, movement is handled by updateCamera()
+                        keyboard(event.key.keysym.scancode);
+                    break;
+                case SDL_MOUSEBUTTONDOWN:
+                    if (event.button.button == SDL_BUTTON_RIGHT)
+                        SDL_SetRelativeMouseMode(SDL_TRUE);
                     break;
                 case SDL_MOUSEBUTTONUP:
                     if (event.button.button == SDL_BUTTON_LEFT)
                         mouse(event.button.x, event.button.y);
+                    else if (event.button.button == SDL_BUTTON_RIGHT)
+                        SDL_SetRelativeMouseMode(SDL_FALSE);
                     break;
             }
 
+        // Sample input right before rendering, so it shows up in the very next frame
+        Uint64 counter = SDL_GetPerformanceCounter();
+        GLfloat frame_seconds = (GLfloat) (counter - last_counter) / SDL_GetPerformanceFrequency();
+        last_counter = counter;
+        updateCamera(frame_seconds < MAX_FRAME_TIME ? frame_seconds : MAX_FRAME_TIME);
+
         renderScene();
         Uint32 time = SDL_GetTicks();
         delta += time - last_time;
         while (delta >= dt) { // Maintain constant physics step and free framerate
-            physicsStep(dt);
+            TelemetryScope scope(TELEMETRY_PHYSICS);
+            physicsStep(dt, nbody_mode);
             delta -= dt;
+
+            if (shm_name) {
+                GLfloat camera[9] = {xpos, ypos, zpos, sight_x, sight_y, sight_z, up_x, up_y, up_z};
+                shmExportPublish(planets, days, sunPhase, camera);
+            }
         }
         frames++;
         last_time = time;
+
+        if (snapshot_path && time - last_checkpoint >= SNAPSHOT_INTERVAL) {
+            snapshotCheckpoint(snapshot_path, currentState(), nbody, countBodies(planets), generate ? seed : 0);
+            last_checkpoint = time;
+        }
+
+        telemetryEndFrame();
+        if (frame_limit && frames >= frame_limit)
+            running = false;
     }
 
-    glDeleteTextures(1, &starsTexture);
-    glDeleteTextures(1, &sunTexture);
+    if (snapshot_path) {
+        if (!find_events && !server_path && !status) // Those do not move the clock, a failed start has nothing to save
+            snapshotSave(snapshot_path, currentState(), nbody, countBodies(planets), generate ? seed : 0);
+        snapshotStop();
+    }
+
+    if (dump_telemetry)
+        textureDump(stderr);
+
+    // Bodies release their textures, while there is still a context to delete them in
+    planets.clear();
+    if (generate)
+        freeGeneratedScene();
+    releaseTexture(starsTexture);
+    releaseTexture(sunTexture);
     freeTextures();
+    freeTrails();
+    nbody.releaseBuffer();
+    dynamicResolutionFree();
+    domeFree();
+    shmExportClose();
 
     SDL_GL_DeleteContext(glcontext);
     SDL_DestroyWindow(window);
     SDL_Quit();
 
-    return 0;
+    if (dump_telemetry)
+        telemetryDump(stderr);
+
+    return telemetryViolations() ? 2 : status;
 }
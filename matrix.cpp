@@ -0,0 +1,62 @@
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+#include <string.h>
+
+#include "matrix.h"
+
+void matrixIdentity(GLfloat m[16]) {
+    memset(m, 0, 16 * sizeof(GLfloat));
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+}
+
+static void matrixMultiply(GLfloat m[16], const GLfloat r[16]) {
+    GLfloat result[16];
+
+    for (int col = 0; col < 4; col++)
+        for (int row = 0; row < 4; row++)
+            result[col*4 + row] = m[row]      * r[col*4]     +
+                                  m[4 + row]  * r[col*4 + 1] +
+                                  m[8 + row]  * r[col*4 + 2] +
+                                  m[12 + row] * r[col*4 + 3];
+
+    memcpy(m, result, sizeof(result));
+}
+
+// Same matrix as glRotatef produces, see its man page
+void matrixRotate(GLfloat m[16], GLfloat angle, GLfloat x, GLfloat y, GLfloat z) {
+    GLfloat norm = sqrtf(x*x + y*y + z*z);
+    if (norm == 0.0f)
+        return;
+    x /= norm; y /= norm; z /= norm;
+
+    GLfloat c = cosf(angle * M_PI / 180.0f), s = sinf(angle * M_PI / 180.0f);
+    GLfloat r[16] = {
+        x*x*(1 - c) + c,   y*x*(1 - c) + z*s, x*z*(1 - c) - y*s, 0.0f,
+        x*y*(1 - c) - z*s, y*y*(1 - c) + c,   y*z*(1 - c) + x*s, 0.0f,
+        x*z*(1 - c) + y*s, y*z*(1 - c) - x*s, z*z*(1 - c) + c,   0.0f,
+        0.0f,              0.0f,              0.0f,              1.0f
+    };
+
+    matrixMultiply(m, r);
+}
+
+void matrixTranslate(GLfloat m[16], GLfloat x, GLfloat y, GLfloat z) {
+    for (int row = 0; row < 4; row++)
+        m[12 + row] += m[row] * x + m[4 + row] * y + m[8 + row] * z;
+}
+
+void matrixTransformPoint(const GLfloat m[16], GLfloat x, GLfloat y, GLfloat z, GLfloat &out_x, GLfloat &out_y, GLfloat &out_z) {
+    out_x = m[0]*x + m[4]*y + m[8]*z + m[12];
+    out_y = m[1]*x + m[5]*y + m[9]*z + m[13];
+    out_z = m[2]*x + m[6]*y + m[10]*z + m[14];
+}
+
+void matrixTransformVector(const GLfloat m[16], GLfloat x, GLfloat y, GLfloat z, GLfloat &out_x, GLfloat &out_y, GLfloat &out_z) {
+    out_x = m[0]*x + m[4]*y + m[8]*z;
+    out_y = m[1]*x + m[5]*y + m[9]*z;
+    out_z = m[2]*x + m[6]*y + m[10]*z;
+}
@@ -0,0 +1,23 @@
+
+#ifndef MATRIX_H
+#define MATRIX_H
+
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+/*
+ * CPU-side counterparts of glLoadIdentity, glRotatef and glTranslatef.
+ * Matrices are column-major, just like OpenGL ones, and every operation
+ * post-multiplies the given matrix, so the same sequence of calls
+ * produces the same matrix as it would on the modelview stack.
+ */
+void matrixIdentity(GLfloat m[16]);
+void matrixRotate(GLfloat m[16], GLfloat angle, GLfloat x, GLfloat y, GLfloat z); // angle in degrees
+void matrixTranslate(GLfloat m[16], GLfloat x, GLfloat y, GLfloat z);
+void matrixTransformPoint(const GLfloat m[16], GLfloat x, GLfloat y, GLfloat z, GLfloat &out_x, GLfloat &out_y, GLfloat &out_z);
+void matrixTransformVector(const GLfloat m[16], GLfloat x, GLfloat y, GLfloat z, GLfloat &out_x, GLfloat &out_y, GLfloat &out_z);
+
+#endif
@@ -0,0 +1,251 @@
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <chrono>
+#include <vector>
+
+#include "constants.h"
+#include "thread_pool.h"
+#include "mpc_import.h"
+
+/*
+ * Column layout of MPCORB.DAT, 1-based and inclusive,
+ * see https://minorplanetcenter.net/iau/info/MPOrbitFormat.html
+ */
+#define MPC_MEAN_ANOMALY 27, 35
+#define MPC_ARG_PERIAPSIS 38, 46
+#define MPC_ASC_NODE 49, 57
+#define MPC_INCLINATION 60, 68
+#define MPC_ECCENTRICITY 71, 79
+#define MPC_SEMIMAJOR_AXIS 93, 103
+#define MPC_MIN_LINE_LENGTH 103
+
+struct MappedFile {
+    const char *data;
+    size_t size;
+#ifdef _WIN32
+    HANDLE file, mapping;
+#endif
+};
+
+static bool mapFile(const char *filename, MappedFile &mapped) {
+#ifdef _WIN32
+    mapped.file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (mapped.file == INVALID_HANDLE_VALUE) {
+        fprintf(stderr, "Cannot open orbit catalog %s\n", filename);
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    GetFileSizeEx(mapped.file, &size);
+    mapped.size = size.QuadPart;
+    mapped.data = NULL;
+    mapped.mapping = NULL;
+    if (!mapped.size)
+        return true;
+
+    mapped.mapping = CreateFileMappingA(mapped.file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapped.mapping)
+        mapped.data = (const char*) MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!mapped.data) {
+        fprintf(stderr, "Cannot map orbit catalog %s\n", filename);
+        if (mapped.mapping)
+            CloseHandle(mapped.mapping);
+        CloseHandle(mapped.file);
+        return false;
+    }
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Cannot open orbit catalog");
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        perror("Cannot stat orbit catalog");
+        close(fd);
+        return false;
+    }
+    mapped.size = st.st_size;
+    mapped.data = NULL;
+    if (!mapped.size) {
+        close(fd);
+        return true;
+    }
+
+    void *mem = mmap(NULL, mapped.size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        perror("Cannot map orbit catalog");
+        return false;
+    }
+    madvise(mem, mapped.size, MADV_SEQUENTIAL);
+    mapped.data = (const char*) mem;
+#endif
+    return true;
+}
+
+static void unmapFile(MappedFile &mapped) {
+#ifdef _WIN32
+    if (mapped.data)
+        UnmapViewOfFile(mapped.data);
+    if (mapped.mapping)
+        CloseHandle(mapped.mapping);
+    CloseHandle(mapped.file);
+#else
+    if (mapped.data)
+        munmap((void*) mapped.data, mapped.size);
+#endif
+}
+
+/*
+ * Parses a right-aligned decimal like "  0.1234567" from the given columns.
+ * Much faster than strtod and does not depend on the locale; catalog fields
+ * never use exponents.
+ */
+static bool parseColumns(const char *line, int first, int last, double &value) {
+    const char *p = line + first - 1, *end = line + last;
+
+    while (p < end && *p == ' ')
+        p++;
+
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    double result = 0.0, scale = 1.0;
+    bool digits = false, fraction = false;
+    for (; p < end && *p != ' '; p++) {
+        if (*p == '.' && !fraction) {
+            fraction = true;
+        } else if (*p >= '0' && *p <= '9') {
+            result = result * 10 + (*p - '0');
+            if (fraction)
+                scale *= 10;
+            digits = true;
+        } else {
+            return false;
+        }
+    }
+
+    // Only trailing blanks are allowed after the number
+    for (; p < end; p++)
+        if (*p != ' ')
+            return false;
+
+    value = (negative ? -result : result) / scale;
+    return digits;
+}
+
+static bool parseOrbit(const char *line, size_t length, Particle &particle) {
+    if (length < MPC_MIN_LINE_LENGTH)
+        return false;
+
+    double M, peri, node, incl, e, a;
+    if (!parseColumns(line, MPC_MEAN_ANOMALY, M) ||
+        !parseColumns(line, MPC_ARG_PERIAPSIS, peri) ||
+        !parseColumns(line, MPC_ASC_NODE, node) ||
+        !parseColumns(line, MPC_INCLINATION, incl) ||
+        !parseColumns(line, MPC_ECCENTRICITY, e) ||
+        !parseColumns(line, MPC_SEMIMAJOR_AXIS, a))
+        return false;
+
+    if (a <= 0.0 || e < 0.0 || e >= 1.0) // Bound orbits only
+        return false;
+
+    particle = NBody::keplerianParticle(ASTRONOMIC_UNIT * a, e, incl, node, peri, M);
+    return true;
+}
+
+long importMPCOrbits(const char *filename, NBody &nbody) {
+    auto started = std::chrono::steady_clock::now();
+
+    MappedFile mapped;
+    if (!mapFile(filename, mapped))
+        return -1;
+
+    // Chunk boundaries, each moved forward to the start of the next line
+    std::vector<size_t> bounds(1, 0);
+    for (size_t pos = MPC_CHUNK_SIZE; pos < mapped.size; pos += MPC_CHUNK_SIZE) {
+        if (pos <= bounds.back())
+            continue;
+        const char *newline = (const char*) memchr(mapped.data + pos, '\n', mapped.size - pos);
+        if (!newline)
+            break;
+        bounds.push_back(newline - mapped.data + 1);
+    }
+    if (bounds.back() != mapped.size)
+        bounds.push_back(mapped.size);
+    size_t chunks = bounds.size() - 1;
+
+    // Pass 1: lines per chunk, an upper bound of orbits in it
+    std::vector<size_t> offsets(chunks + 1, 0), parsed(chunks, 0);
+    threadPool().parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk++) {
+            const char *p = mapped.data + bounds[chunk], *stop = mapped.data + bounds[chunk + 1];
+            size_t lines = 0;
+            while (p < stop && (p = (const char*) memchr(p, '\n', stop - p))) {
+                lines++;
+                p++;
+            }
+            if (bounds[chunk + 1] > bounds[chunk] && mapped.data[bounds[chunk + 1] - 1] != '\n')
+                lines++; // Last line without a newline
+            offsets[chunk + 1] = lines;
+        }
+    });
+    for (size_t chunk = 0; chunk < chunks; chunk++)
+        offsets[chunk + 1] += offsets[chunk];
+
+    size_t first = nbody.size();
+    Particle *storage = nbody.allocate(offsets[chunks]);
+
+    // Pass 2: parse every chunk straight into its own part of the storage
+    threadPool().parallelFor(chunks, 1, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; chunk++) {
+            const char *p = mapped.data + bounds[chunk], *stop = mapped.data + bounds[chunk + 1];
+            Particle *out = storage + offsets[chunk];
+
+            while (p < stop) {
+                const char *newline = (const char*) memchr(p, '\n', stop - p);
+                const char *line_end = newline ? newline : stop;
+                size_t length = line_end - p;
+                if (length && p[length - 1] == '\r')
+                    length--;
+
+                if (parseOrbit(p, length, *out))
+                    out++;
+
+                p = line_end + 1;
+            }
+
+            parsed[chunk] = out - (storage + offsets[chunk]);
+        }
+    });
+
+    // Squeeze out the holes left by non-orbit lines
+    size_t total = 0;
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        if (total != offsets[chunk])
+            memmove(storage + total, storage + offsets[chunk], parsed[chunk] * sizeof(Particle));
+        total += parsed[chunk];
+    }
+    nbody.shrink(first + total);
+
+    unmapFile(mapped);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    fprintf(stderr, "Imported %lu orbits from %s in %.2f s (%.0f MB/s, %u threads)\n",
+            (unsigned long) total, filename, seconds, mapped.size / 1e6 / (seconds > 0 ? seconds : 1e-9), threadPool().size());
+
+    return total;
+}
@@ -0,0 +1,28 @@
+
+#ifndef MPC_IMPORT_H
+#define MPC_IMPORT_H
+
+#include <stddef.h>
+
+#include "nbody.h"
+
+#define MPC_CHUNK_SIZE (4 << 20) // Bytes of text parsed by one task
+
+/*
+ * Imports an MPCORB-style fixed-width orbit catalog as N-body test particles.
+ *
+ * The file is memory-mapped and cut into MPC_CHUNK_SIZE chunks at line
+ * boundaries. One parallel pass counts lines per chunk, so particles can be
+ * allocated once in their final place; a second one parses elements and
+ * converts them to state vectors right into that storage. Lines that are not
+ * orbits (header, blank lines) are squeezed out afterwards. Peak memory is
+ * the resulting particles plus the mapping, which is just page cache.
+ *
+ * Elements are taken as is, ignoring their epoch: mean anomaly given in the
+ * catalog is placed at simulation time zero.
+ *
+ * Returns number of imported orbits or -1 if the file could not be read.
+ */
+long importMPCOrbits(const char *filename, NBody &nbody);
+
+#endif
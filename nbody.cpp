@@ -0,0 +1,387 @@
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+#include <GL/gl.h>
+
+#include <random>
+
+#include "constants.h"
+#include "gl_extensions.h"
+#include "matrix.h"
+#include "telemetry.h"
+#include "thread_pool.h"
+#include "nbody.h"
+
+#define TREE_MAX_DEPTH 32 // Coincident bodies are merged into one leaf below this depth
+#define PARTICLES_PER_TASK 512
+
+NBody::NBody() :
+    accelerations_valid(false),
+    vertex_buffer(0),
+    buffer_valid(false)
+{
+}
+
+void NBody::addParticle(const Particle &particle) {
+    particles.push_back(particle);
+    accelerations_valid = false;
+    buffer_valid = false;
+}
+
+Particle *NBody::allocate(size_t count) {
+    size_t first = particles.size();
+    particles.resize(first + count);
+    accelerations_valid = false;
+    buffer_valid = false; // Filled in by the caller before the next render()
+    return particles.data() + first; // Also valid for count 0 on an empty vector
+}
+
+void NBody::shrink(size_t count) {
+    if (count < particles.size())
+        particles.resize(count);
+    accelerations_valid = false;
+    buffer_valid = false;
+}
+
+void NBody::addKeplerianParticle(double a, double e, double incl, double asc_node, double arg_periapsis, double mean_anomaly, double mass) {
+    addParticle(keplerianParticle(a, e, incl, asc_node, arg_periapsis, mean_anomaly, mass));
+}
+
+/*
+ * Converts orbital elements into a state vector, using the same frame as
+ * Planet::orbitFrame(). Unlike Planet, the orbit is a true Keplerian one,
+ * with the Sun in its focus.
+ */
+Particle NBody::keplerianParticle(double a, double e, double incl, double asc_node, double arg_periapsis, double mean_anomaly, double mass) {
+    double M = fmod(mean_anomaly * M_PI / 180.0, 2*M_PI);
+    double E = e < 0.8 ? M : M_PI;
+    for (int i = 0; i < 20; i++) { // Newton iterations for Kepler's equation
+        double dE = (E - e * sin(E) - M) / (1 - e * cos(E));
+        E -= dE;
+        if (fabs(dE) < 1e-12)
+            break;
+    }
+
+    double b = a * sqrt(1 - e*e);
+    double E_dot = sqrt(SUN_GM * (1 + mass) / (a*a*a)) / (1 - e * cos(E));
+
+    // '-' for counterclockwise orbiting, see Planet::evaluate()
+    double orbit_x = a * (cos(E) - e), orbit_z = -b * sin(E);
+    double orbit_vx = -a * sin(E) * E_dot, orbit_vz = -b * cos(E) * E_dot;
+
+    GLfloat mat[16];
+    matrixIdentity(mat);
+    matrixRotate(mat, ECLIPTIC_INCLINATION, 0.0f, 0.0f, 1.0f);
+    matrixRotate(mat, asc_node, 0.0f, 1.0f, 0.0f);
+    matrixRotate(mat, incl, 0.0f, 0.0f, 1.0f);
+    matrixRotate(mat, arg_periapsis, 0.0f, 1.0f, 0.0f);
+
+    Particle particle;
+    particle.x = mat[0]*orbit_x + mat[8]*orbit_z;
+    particle.y = mat[1]*orbit_x + mat[9]*orbit_z;
+    particle.z = mat[2]*orbit_x + mat[10]*orbit_z;
+    particle.vx = mat[0]*orbit_vx + mat[8]*orbit_vz;
+    particle.vy = mat[1]*orbit_vx + mat[9]*orbit_vz;
+    particle.vz = mat[2]*orbit_vx + mat[10]*orbit_vz;
+    particle.ax = particle.ay = particle.az = 0.0;
+    particle.mass = mass;
+
+    return particle;
+}
+
+void NBody::seedBelt(size_t count, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> semimajor(2.1, 3.3), eccentricity(0.0, 0.2), inclination(0.0, 15.0), angle(0.0, 360.0);
+
+    particles.reserve(particles.size() + count);
+    for (size_t i = 0; i < count; i++) {
+        double a = ASTRONOMIC_UNIT * semimajor(rng);
+        double e = eccentricity(rng), incl = inclination(rng);
+        double node = angle(rng), peri = angle(rng), M = angle(rng);
+        addKeplerianParticle(a, e, incl, node, peri, M);
+    }
+}
+
+void NBody::clear() {
+    particles.clear();
+    accelerations_valid = false;
+    buffer_valid = false;
+}
+
+void NBody::invalidateAccelerations() {
+    accelerations_valid = false;
+}
+
+/*
+ * Kick-drift-kick leapfrog. Planets must already be moved to the end of the
+ * step, so that the closing kick sees the perturbers where they are now.
+ */
+void NBody::step(double days, const std::vector<Planet> &planets) {
+    if (particles.empty())
+        return;
+
+    if (!accelerations_valid) {
+        gatherSources(planets);
+        computeAccelerations(0.0);
+        accelerations_valid = true;
+    }
+
+    threadPool().parallelFor(particles.size(), PARTICLES_PER_TASK, [this, days](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Particle &p = particles[i];
+            p.vx += p.ax * days / 2; p.vy += p.ay * days / 2; p.vz += p.az * days / 2;
+            p.x += p.vx * days;      p.y += p.vy * days;      p.z += p.vz * days;
+        }
+    });
+
+    gatherSources(planets);
+    computeAccelerations(days / 2);
+    buffer_valid = false;
+}
+
+void NBody::gatherPlanet(const Planet &planet, const GLfloat *parent) {
+    GLfloat mat[16];
+    planet.bodyFrame(mat, parent);
+
+    if (planet.getMass() > 0.0f) {
+        Source source = {mat[12], mat[13], mat[14], SUN_GM * planet.getMass()};
+        sources.push_back(source);
+    }
+
+    const std::vector<Planet> &moons = planet.getMoons();
+    for (auto it = moons.begin(); it != moons.end(); it++)
+        gatherPlanet(*it, mat);
+}
+
+// The Sun is not a source: its term is added separately for every particle
+void NBody::gatherSources(const std::vector<Planet> &planets) {
+    sources.clear();
+
+    for (auto it = planets.begin(); it != planets.end(); it++)
+        gatherPlanet(*it, NULL);
+
+    for (auto it = particles.begin(); it != particles.end(); it++)
+        if (it->mass > 0.0) {
+            Source source = {it->x, it->y, it->z, SUN_GM * it->mass};
+            sources.push_back(source);
+        }
+
+    if (sources.size() > NBODY_TREE_THRESHOLD)
+        buildTree();
+    else
+        tree.clear();
+}
+
+int NBody::newNode(double cx, double cy, double cz, double half) {
+    Node node;
+    node.x = node.y = node.z = node.gm = 0.0;
+    node.cx = cx; node.cy = cy; node.cz = cz;
+    node.half = half;
+    for (int i = 0; i < 8; i++)
+        node.children[i] = -1;
+    node.first = -1;
+    node.leaf = true;
+
+    tree.push_back(node);
+    return tree.size() - 1;
+}
+
+void NBody::buildTree() {
+    tree.clear();
+    source_next.assign(sources.size(), -1);
+
+    double min_x = sources[0].x, max_x = sources[0].x;
+    double min_y = sources[0].y, max_y = sources[0].y;
+    double min_z = sources[0].z, max_z = sources[0].z;
+    for (auto it = sources.begin(); it != sources.end(); it++) {
+        min_x = fmin(min_x, it->x); max_x = fmax(max_x, it->x);
+        min_y = fmin(min_y, it->y); max_y = fmax(max_y, it->y);
+        min_z = fmin(min_z, it->z); max_z = fmax(max_z, it->z);
+    }
+    double half = fmax(max_x - min_x, fmax(max_y - min_y, max_z - min_z)) / 2 + NBODY_SOFTENING;
+
+    newNode((min_x + max_x) / 2, (min_y + max_y) / 2, (min_z + max_z) / 2, half);
+    for (size_t i = 0; i < sources.size(); i++)
+        insert(0, i, 0);
+
+    summarize(0);
+}
+
+// Works with indices only: tree may be reallocated by newNode()
+void NBody::insert(int node, int source, int depth) {
+    if (!tree[node].leaf) {
+        insertIntoChild(node, source, depth);
+        return;
+    }
+
+    if (tree[node].first == -1 || depth >= TREE_MAX_DEPTH) {
+        source_next[source] = tree[node].first;
+        tree[node].first = source;
+        return;
+    }
+
+    // Occupied leaf: push its body one level down and try again
+    int old = tree[node].first;
+    tree[node].first = -1;
+    tree[node].leaf = false;
+    insertIntoChild(node, old, depth);
+    insertIntoChild(node, source, depth);
+}
+
+void NBody::insertIntoChild(int node, int source, int depth) {
+    const Source &s = sources[source];
+    int octant = (s.x > tree[node].cx) | (s.y > tree[node].cy) << 1 | (s.z > tree[node].cz) << 2;
+
+    if (tree[node].children[octant] == -1) {
+        double half = tree[node].half / 2;
+        int child = newNode(tree[node].cx + (octant & 1 ? half : -half),
+                            tree[node].cy + (octant & 2 ? half : -half),
+                            tree[node].cz + (octant & 4 ? half : -half),
+                            half);
+        tree[node].children[octant] = child;
+    }
+
+    insert(tree[node].children[octant], source, depth + 1);
+}
+
+void NBody::summarize(int node) {
+    double x = 0.0, y = 0.0, z = 0.0, gm = 0.0;
+
+    if (tree[node].leaf) {
+        for (int i = tree[node].first; i != -1; i = source_next[i]) {
+            x += sources[i].x * sources[i].gm;
+            y += sources[i].y * sources[i].gm;
+            z += sources[i].z * sources[i].gm;
+            gm += sources[i].gm;
+        }
+    } else {
+        for (int i = 0; i < 8; i++) {
+            int child = tree[node].children[i];
+            if (child == -1)
+                continue;
+            summarize(child);
+            x += tree[child].x * tree[child].gm;
+            y += tree[child].y * tree[child].gm;
+            z += tree[child].z * tree[child].gm;
+            gm += tree[child].gm;
+        }
+    }
+
+    Node &n = tree[node];
+    n.gm = gm;
+    if (gm > 0.0) {
+        n.x = x / gm; n.y = y / gm; n.z = z / gm;
+    }
+}
+
+static inline void addAttraction(double dx, double dy, double dz, double gm, double &ax, double &ay, double &az) {
+    double r2 = dx*dx + dy*dy + dz*dz + NBODY_SOFTENING * NBODY_SOFTENING;
+    double f = gm / (r2 * sqrt(r2));
+    ax += f * dx; ay += f * dy; az += f * dz;
+}
+
+void NBody::acceleration(double x, double y, double z, double &ax, double &ay, double &az) const {
+    ax = ay = az = 0.0;
+    addAttraction(-x, -y, -z, SUN_GM, ax, ay, az);
+
+    if (tree.empty()) {
+        for (auto it = sources.begin(); it != sources.end(); it++)
+            addAttraction(it->x - x, it->y - y, it->z - z, it->gm, ax, ay, az);
+        return;
+    }
+
+    int stack[8 * TREE_MAX_DEPTH + 8];
+    int top = 0;
+    stack[top++] = 0;
+
+    while (top) {
+        const Node &node = tree[stack[--top]];
+        if (node.gm == 0.0)
+            continue;
+
+        double dx = node.x - x, dy = node.y - y, dz = node.z - z;
+        double size = 2 * node.half;
+
+        if (node.leaf || size * size < NBODY_TREE_THETA * NBODY_TREE_THETA * (dx*dx + dy*dy + dz*dz)) {
+            addAttraction(dx, dy, dz, node.gm, ax, ay, az);
+        } else {
+            for (int i = 0; i < 8; i++)
+                if (node.children[i] != -1)
+                    stack[top++] = node.children[i];
+        }
+    }
+}
+
+// Fresh accelerations for every particle, then velocity += kick * acceleration
+void NBody::computeAccelerations(double kick) {
+    threadPool().parallelFor(particles.size(), PARTICLES_PER_TASK, [this, kick](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            Particle &p = particles[i];
+            acceleration(p.x, p.y, p.z, p.ax, p.ay, p.az);
+            p.vx += p.ax * kick; p.vy += p.ay * kick; p.vz += p.az * kick;
+        }
+    });
+}
+
+// Single precision is what planets are drawn with too
+void NBody::uploadPositions() const {
+    if (!vertex_buffer) {
+        pglGenBuffers(1, &vertex_buffer);
+        telemetryCountGLCreate();
+    }
+
+    size_t size = particles.size() * 3 * sizeof(GLfloat);
+    pglBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+    pglBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW); // Orphaned, frames still drawing the old one keep it
+    GLfloat *out = (GLfloat*) pglMapBuffer(GL_ARRAY_BUFFER, GL_WRITE_ONLY);
+    if (out) {
+        for (auto it = particles.begin(); it != particles.end(); it++) {
+            *(out++) = it->x;
+            *(out++) = it->y;
+            *(out++) = it->z;
+        }
+        buffer_valid = pglUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE; // Contents are lost if not
+        telemetryCountUpload(size);
+    }
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void NBody::render() const {
+    if (particles.empty())
+        return;
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glColor3f(0.7f, 0.7f, 0.6f);
+    glPointSize(1.0f);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    if (glHasBuffers && !buffer_valid)
+        uploadPositions();
+
+    if (buffer_valid) {
+        pglBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+        glVertexPointer(3, GL_FLOAT, 0, NULL);
+        glDrawArrays(GL_POINTS, 0, particles.size());
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    } else { // Straight from memory, every time
+        glVertexPointer(3, GL_DOUBLE, sizeof(Particle), &particles[0].x);
+        glDrawArrays(GL_POINTS, 0, particles.size());
+    }
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_LIGHTING);
+}
+
+void NBody::releaseBuffer() {
+    if (vertex_buffer) {
+        pglDeleteBuffers(1, &vertex_buffer);
+        telemetryCountGLDelete();
+    }
+    vertex_buffer = 0;
+    buffer_valid = false;
+}
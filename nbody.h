@@ -0,0 +1,91 @@
+
+#ifndef NBODY_H
+#define NBODY_H
+
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+#include <stddef.h>
+#include <vector>
+
+#include "planet.h"
+
+struct Particle {
+    double x, y, z;    // Scene units, same frame as planets are rendered in
+    double vx, vy, vz; // Scene units per day
+    double ax, ay, az; // Acceleration from the last force evaluation
+    double mass;       // In solar masses, 0 for test particles
+};
+
+/*
+ * Gravitational N-body mode. Particles move in the field of the Sun (fixed at
+ * the origin), of every elements-based Planet with non-zero mass, and of each
+ * other if they have mass themselves. Integration is kick-drift-kick leapfrog,
+ * which is symplectic, so orbits do not spiral in or out over long runs.
+ *
+ * Force evaluation is spread over threadPool(). Massive bodies are summed
+ * directly while there are few of them and through a Barnes-Hut octree above
+ * NBODY_TREE_THRESHOLD, so tens of thousands of test particles cost
+ * O(N * planets) and self-gravitating sets cost O(N log N).
+ */
+class NBody {
+public:
+    NBody();
+
+    void addParticle(const Particle &particle);
+    // a in scene units, angles in degrees, same meaning as Planet's constructor arguments
+    void addKeplerianParticle(double a, double e, double incl, double asc_node, double arg_periapsis, double mean_anomaly, double mass = 0.0);
+    void seedBelt(size_t count, unsigned seed); // Main asteroid belt between 2.1 and 3.3 AU
+    void clear();
+
+    // Bulk loading: allocate() appends count particles to be filled in by the caller, shrink() drops the tail
+    Particle *allocate(size_t count);
+    void shrink(size_t count);
+
+    // Thread-safe, does not touch any NBody
+    static Particle keplerianParticle(double a, double e, double incl, double asc_node, double arg_periapsis, double mean_anomaly, double mass = 0.0);
+
+    void step(double days, const std::vector<Planet> &planets);
+    void invalidateAccelerations(); // Planets moved without the particles, e.g. while N-body mode was off
+    void render() const; // Positions go to the GPU once after every change, however many times they are drawn
+    void releaseBuffer(); // Needs the context the particles were drawn in
+
+    size_t size() const { return particles.size(); }
+    const std::vector<Particle> &getParticles() const { return particles; }
+
+private:
+    struct Source {
+        double x, y, z, gm;
+    };
+    struct Node {
+        double x, y, z, gm;       // Center of mass and total GM of the subtree
+        double cx, cy, cz, half;  // Cell center and half of its side
+        int children[8];
+        int first;                // Sources of a leaf, chained through source_next
+        bool leaf;
+    };
+
+    std::vector<Particle> particles;
+    std::vector<Source> sources;
+    std::vector<Node> tree;
+    std::vector<int> source_next;
+    bool accelerations_valid;
+    mutable GLuint vertex_buffer;
+    mutable bool buffer_valid;
+
+    void gatherSources(const std::vector<Planet> &planets);
+    void gatherPlanet(const Planet &planet, const GLfloat *parent);
+    void buildTree();
+    int newNode(double cx, double cy, double cz, double half);
+    void insert(int node, int source, int depth);
+    void insertIntoChild(int node, int source, int depth);
+    void summarize(int node);
+    void acceleration(double x, double y, double z, double &ax, double &ay, double &az) const;
+    void computeAccelerations(double kick);
+    void uploadPositions() const;
+};
+
+#endif
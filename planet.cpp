@@ -4,14 +4,17 @@
 #include <windows.h>
 #define _USE_MATH_DEFINES
 #endif
+#include <float.h>
 #include <math.h>
+#include <string.h>
 #include <GL/gl.h>
 #include <GL/glu.h>
 
 #include "constants.h"
-#include "bmp_loader.h"
+#include "matrix.h"
 #include "rendering.h"
 #include "planet.h"
+#include "telemetry.h"
 
 void drawTorus(double, int, int);
 
@@ -26,7 +29,8 @@ Planet::Planet(GLfloat radius_,
                GLfloat arg_periapsis_,
                const char *texture_file,
                GLfloat phi,
-               const char *name_) :
+               const char *name_,
+               GLfloat mass_) :
     radius(radius_),
     semimajor_axis(semimajor_axis_),
     siderial_year(siderial_year_),
@@ -35,15 +39,23 @@ Planet::Planet(GLfloat radius_,
     axis_inclination(axis_inclination_),
     asc_node(asc_node_),
     arg_periapsis(arg_periapsis_),
+    initial_phi(phi),
     orbitX(0.0f),
     orbitZ(0.0f),
     orbitPHI(phi),
     phase(0.0f),
+    state_days(NAN),
+    mass(mass_),
+    texture(acquireTexture(texture_file)),
+    titleX(0),
+    titleY(0),
+    title_width(0),
+    title_height(0),
+    title_priority(0.0f),
     name(name_),
     title_is_visible(false)
 {
     semiminor_axis = semimajor_axis * sqrtf(1.0f - eccentricity*eccentricity);
-    texture = loadBMPTexture(texture_file);
 }
 
 Planet::Planet(Planet &&rvalue) :
@@ -56,10 +68,18 @@ Planet::Planet(Planet &&rvalue) :
     axis_inclination(rvalue.axis_inclination),
     asc_node(rvalue.asc_node),
     arg_periapsis(rvalue.arg_periapsis),
+    initial_phi(rvalue.initial_phi),
     orbitX(rvalue.orbitX),
     orbitZ(rvalue.orbitZ),
     orbitPHI(rvalue.orbitPHI),
     phase(rvalue.phase),
+    state_days(rvalue.state_days),
+    mass(rvalue.mass),
+    titleX(rvalue.titleX),
+    titleY(rvalue.titleY),
+    title_width(rvalue.title_width),
+    title_height(rvalue.title_height),
+    title_priority(rvalue.title_priority),
     name(rvalue.name),
     title_is_visible(rvalue.title_is_visible)
 {
@@ -70,24 +90,77 @@ Planet::Planet(Planet &&rvalue) :
 }
 
 Planet::~Planet() {
-    glDeleteTextures(1, &texture);
+    releaseTexture(texture);
 }
 
-void Planet::physicsStep(int elapsed) {
-    orbitPHI += DAYS_PER_SECOND * 2*M_PI * elapsed / (1000 * siderial_year);
-    if (orbitPHI >= 2*M_PI)
-        orbitPHI -= 2*M_PI; // Keep it small
+/*
+ * Orbital state is a function of simulation time only, so nobody has to step
+ * every body every tick. It is computed when first asked for at a given time
+ * and reused until the time changes.
+ */
+void Planet::evaluate(double t) const {
+    if (t == state_days)
+        return;
+    state_days = t;
+
+    orbitPHI = fmod(initial_phi + 2*M_PI * t / siderial_year, 2*M_PI);
+
+    double x, z;
+    orbitPosition(t, x, z);
+    orbitX = x;
+    orbitZ = z;
+
+    phase = fmod(360.0 * t / siderial_day, 360.0);
+}
+
+// Leaves memoized state alone, so any thread may ask about any time
+void Planet::orbitPosition(double t, double &x, double &z) const {
+    double phi = fmod(initial_phi + 2*M_PI * t / siderial_year, 2*M_PI);
 
     // '-' for counterclockwise orbiting
-    orbitX = semimajor_axis * cos(-orbitPHI);
-    orbitZ = semiminor_axis * sin(-orbitPHI);
+    x = semimajor_axis * cos(-phi);
+    z = semiminor_axis * sin(-phi);
+}
 
-    phase += 360 * DAYS_PER_SECOND * elapsed / (1000 * siderial_day);
-    if (phase >= 360.0f)
-        phase -= 360.0f;
+GLfloat Planet::getPhase() const {
+    evaluate(days);
+    return phase;
+}
 
+// Radius of the sphere around the orbit center that holds the body and all of its moons
+GLfloat Planet::extent() const {
+    GLfloat moons_extent = 0.0f;
     for (auto it = moons.begin(); it != moons.end(); it++)
-        it->physicsStep(elapsed);
+        moons_extent = fmaxf(moons_extent, it->extent());
+
+    return semimajor_axis + fmaxf(radius, moons_extent);
+}
+
+// Sphere of given radius around the current origin vs. view frustum planes (Gribb & Hartmann)
+static bool originSphereVisible(const GLdouble modelview[16], const GLdouble projection[16], GLdouble r) {
+    GLdouble clip[16];
+    for (int col = 0; col < 4; col++)
+        for (int row = 0; row < 4; row++)
+            clip[col*4 + row] = projection[row]      * modelview[col*4]     +
+                                projection[4 + row]  * modelview[col*4 + 1] +
+                                projection[8 + row]  * modelview[col*4 + 2] +
+                                projection[12 + row] * modelview[col*4 + 3];
+
+    for (int row = 0; row < 3; row++)
+        for (int sign = -1; sign <= 1; sign += 2) {
+            GLdouble a = clip[3] + sign * clip[row], b = clip[7] + sign * clip[4 + row];
+            GLdouble c = clip[11] + sign * clip[8 + row], d = clip[15] + sign * clip[12 + row];
+            if (d < -r * sqrt(a*a + b*b + c*c))
+                return false;
+        }
+
+    return true;
+}
+
+void Planet::hideTitles() {
+    title_is_visible = false;
+    for (auto it = moons.begin(); it != moons.end(); it++)
+        it->hideTitles();
 }
 
 void Planet::render(bool orbit, bool is_moon) {
@@ -101,16 +174,25 @@ void Planet::render(bool orbit, bool is_moon) {
     glRotatef(orbit_inclination, 0.0f, 0.0f, 1.0f); // Now handle inclination
     glRotatef(arg_periapsis, 0.0f, 1.0f, 0.0f); // And finally argument of periapsis
 
-    calculateTitlePosition();
+    GLdouble modelview[16], projection[16];
+    GLint viewport[4];
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
 
-    if (orbit) {
-        glPushMatrix();
-        glRotatef(90.f, 1.0f, 0.0f, 0.0f);
-        glScalef(1.0f, semiminor_axis / semimajor_axis, 1.0f);
-        drawTorus(semimajor_axis, 5, 300);
+    // Whole orbit is off the screen: no need to even know where the body is
+    if (!originSphereVisible(modelview, projection, extent())) {
+        hideTitles();
         glPopMatrix();
+        return;
     }
 
+    evaluate(days);
+    calculateTitlePosition(modelview, projection, viewport);
+
+    if (orbit)
+        renderOrbit();
+
     /*
     glBegin(GL_LINES);
     glVertex3f(-semimajor_axis, 0.0f, 0.0f);
@@ -125,13 +207,38 @@ void Planet::render(bool orbit, bool is_moon) {
     for (auto it = moons.begin(); it != moons.end(); it++)
         it->render(orbit, true);
 
+    // Behind the camera or smaller than a pixel: the sphere would not show up anyway
+    GLdouble eye_z = modelview[2]*orbitX + modelview[10]*orbitZ + modelview[14];
+    if (eye_z - radius >= 0 || radius * projection[5] * viewport[3] / 2 < -eye_z * SUBPIXEL_RADIUS) {
+        glPopMatrix();
+        return;
+    }
+
+    renderSphere();
+    glPopMatrix();
+}
+
+// In orbitFrame()
+void Planet::renderOrbit() const {
+    glPushMatrix();
+    glRotatef(90.f, 1.0f, 0.0f, 0.0f);
+    glScalef(1.0f, semiminor_axis / semimajor_axis, 1.0f);
+    drawTorus(semimajor_axis, 5, 300);
+    glPopMatrix();
+}
+
+// In bodyFrame()
+void Planet::renderSphere() const {
+    glPushMatrix();
+
     glRotatef(axis_inclination, 1.0f, 0.0f, 0.0f); // Axis is inclined wrt orbit
     glRotatef(phase, 0.0f, 1.0f, 0.0f); // Finally handle everyday rotation
 
     glRotatef(90.0f, -1.0f, 0.0f, 0.0f); // Rotate a bit so texture is applied correctly
-    glBindTexture(GL_TEXTURE_2D, texture);
+    bindTexture(texture);
 
     GLUquadricObj *planet = gluNewQuadric();
+    telemetryCountGLCreate();
     gluQuadricDrawStyle(planet, GLU_FILL);
     gluQuadricTexture(planet, GLU_TRUE);
     gluQuadricNormals(planet, GLU_SMOOTH);
@@ -139,6 +246,7 @@ void Planet::render(bool orbit, bool is_moon) {
     gluSphere(planet, radius, 50, 50);
 
     gluDeleteQuadric(planet);
+    telemetryCountGLDelete();
     glBindTexture(GL_TEXTURE_2D, 0);
 
     glPopMatrix();
@@ -149,6 +257,8 @@ void Planet::addMoon(Planet &&moon) {
 }
 
 void Planet::generateLookAt(GLfloat &xpos, GLfloat &ypos, GLfloat &zpos, GLfloat &sight_x, GLfloat &sight_y, GLfloat &sight_z, GLfloat &up_x, GLfloat &up_y, GLfloat &up_z) {
+    evaluate(days);
+
     glPushMatrix();
 
     glLoadIdentity(); // Reset all current transformations
@@ -191,14 +301,30 @@ void Planet::generateLookAt(GLfloat &xpos, GLfloat &ypos, GLfloat &zpos, GLfloat
     sight_z = -z / norm_sight;
 }
 
-void Planet::calculateTitlePosition() {
-    GLdouble modelview[16], projection[16];
-    GLint viewport[4];
-    GLdouble x, y, z;
+/*
+ * CPU version of the rotations done in render(), so positions can be known
+ * without touching OpenGL state (e.g. by N-body force evaluation).
+ */
+void Planet::orbitFrame(GLfloat mat[16], const GLfloat *parent) const {
+    if (parent) {
+        memcpy(mat, parent, 16 * sizeof(GLfloat));
+    } else {
+        matrixIdentity(mat);
+        matrixRotate(mat, ECLIPTIC_INCLINATION, 0.0f, 0.0f, 1.0f);
+    }
+    matrixRotate(mat, asc_node, 0.0f, 1.0f, 0.0f);
+    matrixRotate(mat, orbit_inclination, 0.0f, 0.0f, 1.0f);
+    matrixRotate(mat, arg_periapsis, 0.0f, 1.0f, 0.0f);
+}
 
-    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
-    glGetDoublev(GL_PROJECTION_MATRIX, projection);
-    glGetIntegerv(GL_VIEWPORT, viewport);
+void Planet::bodyFrame(GLfloat mat[16], const GLfloat *parent) const {
+    evaluate(days);
+    orbitFrame(mat, parent);
+    matrixTranslate(mat, orbitX, 0.0f, orbitZ);
+}
+
+void Planet::calculateTitlePosition(const GLdouble modelview[16], const GLdouble projection[16], const GLint viewport[4]) {
+    GLdouble x, y, z;
 
     gluProject(orbitX, 1.5f*radius, orbitZ, modelview, projection, viewport, &x, &y, &z);
     titleX = x;
@@ -206,20 +332,30 @@ void Planet::calculateTitlePosition() {
 
     // Use ModelView matrix as transformation matrix to translate title coordinates to camera-related
     // coordinates. + modelview[14] is essential.
-    GLdouble w_z;
+    GLdouble w_x, w_y, w_z;
+    w_x = modelview[0]*orbitX + modelview[4]*1.5f*radius + modelview[8]*orbitZ + modelview[12];
+    w_y = modelview[1]*orbitX + modelview[5]*1.5f*radius + modelview[9]*orbitZ + modelview[13];
     w_z = modelview[2]*orbitX + modelview[6]*1.5f*radius + modelview[10]*orbitZ + modelview[14];
 
     if (w_z < 0) // Camera looks down the Z axis from the origin, so objects with negative Z are visible
         title_is_visible = true;
     else
         title_is_visible = false;
+
+    // Apparent size: big and close bodies win label collisions
+    title_priority = radius / sqrt(w_x*w_x + w_y*w_y + w_z*w_z);
 }
 
-void Planet::showTitle(const TTF_Font *font) {
-    if (title_is_visible)
-        drawText(name, font, titleX, titleY, true, true);
+void Planet::collectTitles(std::vector<Label> &labels, const TTF_Font *font, const Planet *selected) {
+    if (title_is_visible && *name) {
+        if (!title_width)
+            TTF_SizeText(const_cast<TTF_Font*>(font), name, &title_width, &title_height);
+
+        Label label = {name, titleX, titleY, title_width, title_height, this == selected ? FLT_MAX : title_priority};
+        labels.push_back(label);
+    }
     for (auto it = moons.begin(); it != moons.end(); it++)
-        it->showTitle(font);
+        it->collectTitles(labels, font, selected);
 }
 
 // Taken from google, claimed to be from Red Book
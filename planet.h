@@ -11,19 +11,28 @@
 
 #include <vector>
 
+#include "labels.h"
+#include "texture_manager.h"
+
 class Planet {
 protected:
     GLfloat radius, semimajor_axis, semiminor_axis;
     GLfloat siderial_year, siderial_day;
     GLfloat orbit_inclination, axis_inclination;
     GLfloat asc_node, arg_periapsis;
-    GLfloat orbitX, orbitZ, orbitPHI, phase; // phi in radians, phase in degrees
-    GLuint texture;
+    GLfloat initial_phi;
+    mutable GLfloat orbitX, orbitZ, orbitPHI, phase; // phi in radians, phase in degrees
+    mutable double state_days; // Simulation time the above are valid for
+    GLfloat mass; // In solar masses, only used as a perturber in N-body mode
+    TextureHandle texture;
     std::vector<Planet> moons;
-    GLuint titleX, titleY;
+    GLint titleX, titleY;
+    int title_width, title_height; // Measured once, on first use
+    GLfloat title_priority;
     const char *name;
     bool title_is_visible;
-    void calculateTitlePosition();
+    void calculateTitlePosition(const GLdouble modelview[16], const GLdouble projection[16], const GLint viewport[4]);
+    void hideTitles();
 public:
     Planet(GLfloat radius_,
            GLfloat semimajor_axis_,
@@ -36,14 +45,28 @@ public:
            GLfloat arg_periapsis_,
            const char *texture_file,
            GLfloat phi = 0.0f,
-           const char *name = "");
+           const char *name = "",
+           GLfloat mass_ = 0.0f);
     Planet(Planet &&rvalue);
     ~Planet();
-    void physicsStep(int elapsed);
+    void evaluate(double t) const; // Bring orbital state to time t (days), memoized
+    void orbitPosition(double t, double &x, double &z) const; // Position in orbitFrame() at time t, thread-safe
     void render(bool orbit = false, bool is_moon = false);
+    // Pieces of render() for callers that cull and place bodies themselves, current matrix is the frame named
+    void renderOrbit() const;  // orbitFrame()
+    void renderSphere() const; // bodyFrame(), evaluated for the current time
+    GLfloat extent() const; // Radius of the sphere around the orbit center that holds the body and its moons
     void addMoon(Planet &&moon); // Use rvalue reference to always steal caller's object - avoids copying OpenGL textures
     void generateLookAt(GLfloat &xpos, GLfloat &ypos, GLfloat &zpos, GLfloat &sight_x, GLfloat &sight_y, GLfloat &sight_z, GLfloat &up_x, GLfloat &up_y, GLfloat &up_z);
-    void showTitle(const TTF_Font *font);
+    void collectTitles(std::vector<Label> &labels, const TTF_Font *font, const Planet *selected = NULL);
+    void orbitFrame(GLfloat mat[16], const GLfloat *parent = NULL) const; // Orbital plane, parent is moon's planet bodyFrame()
+    void bodyFrame(GLfloat mat[16], const GLfloat *parent = NULL) const; // Same, translated to the body center
+    GLfloat getMass() const { return mass; }
+    GLfloat getRadius() const { return radius; }
+    GLfloat getYear() const { return siderial_year; }
+    GLfloat getPhase() const;
+    const char *getName() const { return name; }
+    const std::vector<Planet> &getMoons() const { return moons; }
 };
 
 #endif
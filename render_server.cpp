@@ -0,0 +1,352 @@
+#include <ctype.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <vector>
+
+#include "gl_extensions.h"
+#include "bmp_loader.h"
+#include "rendering.h"
+#include "render_server.h"
+#include "telemetry.h"
+
+#ifndef _WIN32
+
+#define MAX_REQUEST_LENGTH 1024
+
+struct RenderRequest {
+    double days;
+    GLfloat camera[9];
+    GLint width, height;
+    bool orbits, labels, date;
+};
+
+/*
+ * Readbacks go through two pixel buffers in turn: glReadPixels() into one of
+ * them only queues a copy, so the next image is rendered while the previous
+ * one is still on its way, and mapping waits just for that older copy.
+ */
+struct Readback {
+    GLuint pbo;
+    size_t capacity;
+    GLint width, height;
+    bool pending;
+};
+
+static GLuint framebuffer = 0, color_buffer = 0, depth_buffer = 0;
+static GLint target_width = 0, target_height = 0;
+static Readback readbacks[2];
+static unsigned next_readback = 0;
+static std::vector<GLubyte> pixels; // Without pixel buffers
+
+static size_t imageSize(GLint width, GLint height) {
+    return (size_t) ((width * 3 + 3) & ~3) * height;
+}
+
+static bool sendAll(int fd, const void *data, size_t size) {
+    const char *ptr = (const char*) data;
+    while (size) {
+        ssize_t sent = write(fd, ptr, size);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent <= 0)
+            return false;
+        ptr += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+static bool sendImage(int fd, const GLubyte *data, GLint width, GLint height) {
+    char reply[64];
+    int reply_len = snprintf(reply, sizeof(reply), "OK %lu\n", (unsigned long) (BMP_HEADER_SIZE + imageSize(width, height)));
+
+    GLubyte header[BMP_HEADER_SIZE];
+    fillBMPHeader(header, width, height);
+
+    return sendAll(fd, reply, reply_len) && sendAll(fd, header, sizeof(header)) &&
+           sendAll(fd, data, imageSize(width, height));
+}
+
+static bool sendError(int fd, const char *message) {
+    char reply[256];
+    int reply_len = snprintf(reply, sizeof(reply), "ERR %s\n", message);
+    return sendAll(fd, reply, reply_len);
+}
+
+static bool resizeTarget(GLint width, GLint height) {
+    if (width == target_width && height == target_height)
+        return true;
+
+    if (!framebuffer) {
+        pglGenFramebuffers(1, &framebuffer);
+        pglGenRenderbuffers(1, &color_buffer);
+        pglGenRenderbuffers(1, &depth_buffer);
+        telemetryCountGLCreate(3);
+    }
+
+    pglBindRenderbuffer(GL_RENDERBUFFER, color_buffer);
+    pglRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    pglBindRenderbuffer(GL_RENDERBUFFER, depth_buffer);
+    pglRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    pglBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color_buffer);
+    pglFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth_buffer);
+    if (pglCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        target_width = target_height = 0;
+        return false;
+    }
+
+    target_width = width;
+    target_height = height;
+    return true;
+}
+
+static void freeTarget() {
+    if (framebuffer) {
+        pglDeleteFramebuffers(1, &framebuffer);
+        pglDeleteRenderbuffers(1, &color_buffer);
+        pglDeleteRenderbuffers(1, &depth_buffer);
+        telemetryCountGLDelete(3);
+    }
+    framebuffer = color_buffer = depth_buffer = 0;
+    target_width = target_height = 0;
+
+    for (int i = 0; i < 2; i++) {
+        if (readbacks[i].pbo) {
+            pglDeleteBuffers(1, &readbacks[i].pbo);
+            telemetryCountGLDelete();
+        }
+        readbacks[i].pbo = 0;
+        readbacks[i].capacity = 0;
+        readbacks[i].pending = false;
+    }
+}
+
+static bool finishReadback(int fd, Readback &readback) {
+    if (!readback.pending)
+        return true;
+    readback.pending = false;
+
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    const GLubyte *data = (const GLubyte*) pglMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    bool sent = data ? sendImage(fd, data, readback.width, readback.height) : sendError(fd, "cannot map pixel buffer");
+    if (data)
+        pglUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return sent;
+}
+
+// Replies must keep request order, so whatever is in flight goes first
+static bool flushReadbacks(int fd) {
+    bool sent = finishReadback(fd, readbacks[next_readback]);
+    return finishReadback(fd, readbacks[next_readback ^ 1]) && sent;
+}
+
+static bool parseRequest(const char *line, RenderRequest &request, const char *&error) {
+    char flags[16] = "-";
+    GLfloat *c = request.camera;
+
+    int fields = sscanf(line, "render %lf %f %f %f %f %f %f %f %f %f %d %d %15s", &request.days,
+                        &c[0], &c[1], &c[2], &c[3], &c[4], &c[5], &c[6], &c[7], &c[8],
+                        &request.width, &request.height, flags);
+    if (fields < 12) {
+        error = "malformed request";
+        return false;
+    }
+
+    GLint max_size = 0;
+    glGetIntegerv(GL_MAX_RENDERBUFFER_SIZE, &max_size);
+    if (request.width <= 0 || request.height <= 0 || request.width > max_size || request.height > max_size) {
+        error = "image size out of range";
+        return false;
+    }
+
+    if (c[3] * c[3] + c[4] * c[4] + c[5] * c[5] == 0.0f || c[6] * c[6] + c[7] * c[7] + c[8] * c[8] == 0.0f) {
+        error = "zero sight or up vector";
+        return false;
+    }
+
+    request.orbits = strchr(flags, 'o') != NULL;
+    request.labels = strchr(flags, 'l') != NULL;
+    request.date = strchr(flags, 'd') != NULL;
+    return true;
+}
+
+static bool render(int fd, const RenderRequest &request, const TTF_Font *font) {
+    TelemetryScope scope(TELEMETRY_SCENE);
+    struct EndFrame { ~EndFrame() { telemetryEndFrame(); } } end_frame; // Every image counts as a frame
+
+    if (!resizeTarget(request.width, request.height))
+        return flushReadbacks(fd) && sendError(fd, "cannot create framebuffer");
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    setPerspective(request.width, request.height);
+    setSimulationTime(request.days);
+    drawScene(request.camera, request.orbits);
+    if (font && (request.labels || request.date))
+        drawSnapshotOverlay(font, request.labels, request.date);
+
+    size_t size = imageSize(request.width, request.height);
+
+    if (!glHasPixelBuffers) {
+        pixels.resize(size);
+        glReadPixels(0, 0, request.width, request.height, GL_BGR, GL_UNSIGNED_BYTE, &pixels[0]);
+        return sendImage(fd, &pixels[0], request.width, request.height);
+    }
+
+    Readback &readback = readbacks[next_readback];
+    if (!readback.pbo) {
+        pglGenBuffers(1, &readback.pbo);
+        telemetryCountGLCreate();
+    }
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pbo);
+    if (readback.capacity < size) {
+        pglBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        readback.capacity = size;
+    }
+    glReadPixels(0, 0, request.width, request.height, GL_BGR, GL_UNSIGNED_BYTE, NULL);
+    pglBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    readback.width = request.width;
+    readback.height = request.height;
+    readback.pending = true;
+
+    // This one is queued now, so it is time to collect the previous image
+    next_readback ^= 1;
+    return finishReadback(fd, readbacks[next_readback]);
+}
+
+// Returns false when the client asks the whole server to stop
+static bool serveClient(int fd, const TTF_Font *font) {
+    std::vector<char> buffer;
+    char chunk[64 * 1024];
+
+    while (true) {
+        ssize_t received = read(fd, chunk, sizeof(chunk));
+        if (received < 0 && errno == EINTR)
+            continue;
+        if (received <= 0)
+            break;
+        buffer.insert(buffer.end(), chunk, chunk + received);
+
+        // Everything that arrived in one go is one batch, rendered back to back
+        size_t start = 0;
+        for (size_t i = 0; i < buffer.size(); i++) {
+            if (buffer[i] != '\n')
+                continue;
+
+            // Commands are whole trimmed lines, so CRLF clients work and nothing merely starts with one
+            size_t end = i;
+            while (end > start && isspace((unsigned char) buffer[end - 1]))
+                end--;
+            buffer[end] = '\0';
+            const char *line = &buffer[start];
+            while (isspace((unsigned char) *line))
+                line++;
+            start = i + 1;
+
+            if (!*line)
+                continue;
+            if (!strcmp(line, "shutdown")) {
+                flushReadbacks(fd);
+                return false;
+            }
+
+            RenderRequest request;
+            const char *error = NULL;
+            bool sent = parseRequest(line, request, error) ? render(fd, request, font) :
+                                                             flushReadbacks(fd) && sendError(fd, error);
+            if (!sent)
+                return true; // Client has gone away
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + start);
+
+        if (buffer.size() > MAX_REQUEST_LENGTH) {
+            flushReadbacks(fd);
+            sendError(fd, "request too long");
+            break;
+        }
+
+        // Nothing more to overlap with, the client may be waiting for these
+        if (!flushReadbacks(fd))
+            break;
+    }
+
+    flushReadbacks(fd);
+    return true;
+}
+
+bool renderServerRun(const char *path, const TTF_Font *font) {
+    if (!glHasFramebuffers) {
+        fprintf(stderr, "Render server needs OpenGL framebuffer objects\n");
+        return false;
+    }
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Socket path is too long: %s\n", path);
+        return false;
+    }
+    strcpy(address.sun_path, path);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server < 0) {
+        perror("Cannot create socket");
+        return false;
+    }
+
+    unlink(path); // Left over from a previous run
+    if (bind(server, (struct sockaddr*) &address, sizeof(address)) < 0 || listen(server, 4) < 0) {
+        perror("Cannot listen on socket");
+        close(server);
+        return false;
+    }
+
+    signal(SIGPIPE, SIG_IGN); // Clients that hang up early are handled by write() errors
+    fprintf(stderr, "Render server listening on %s\n", path);
+
+    bool serving = true;
+    while (serving) {
+        int client = accept(server, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("Cannot accept connection");
+            break;
+        }
+
+        serving = serveClient(client, font);
+        close(client);
+    }
+
+    pglBindFramebuffer(GL_FRAMEBUFFER, 0);
+    freeTarget();
+    close(server);
+    unlink(path);
+
+    return true;
+}
+
+#else
+
+bool renderServerRun(const char *, const TTF_Font *) {
+    fprintf(stderr, "Render server is not supported on this platform\n");
+    return false;
+}
+
+#endif
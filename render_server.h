@@ -0,0 +1,28 @@
+
+#ifndef RENDER_SERVER_H
+#define RENDER_SERVER_H
+
+#include <SDL_ttf.h>
+
+/*
+ * Offscreen snapshot server (see --server). The GL context, textures and
+ * planets stay resident, clients connect to a UNIX socket and send text
+ * requests, one per line:
+ *
+ *   render DAYS X Y Z SX SY SZ UX UY UZ WIDTH HEIGHT [FLAGS]
+ *   shutdown
+ *
+ * DAYS is the simulation time, then come camera position, sight and up
+ * vectors in scene units (1 AU is ASTRONOMIC_UNIT), then image size. FLAGS
+ * is any combination of 'o' (orbits), 'l' (labels) and 'd' (date), or '-'.
+ *
+ * Every request gets a reply in order: "OK SIZE\n" followed by SIZE bytes
+ * of a 24-bit BMP image, or "ERR MESSAGE\n". Clients should send requests
+ * in batches without waiting for replies: the server renders the next
+ * image while the previous one is still being read back from the GPU.
+ */
+
+// Serves requests until a client sends "shutdown". False means the socket could not be set up.
+bool renderServerRun(const char *path, const TTF_Font *font);
+
+#endif
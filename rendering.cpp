@@ -21,14 +21,26 @@
 #include "constants.h"
 #include "planet.h"
 #include "rendering.h"
-#include "bmp_loader.h"
-
-static GLfloat sunPhase = 0.0f;
-static GLfloat days = 0.0f;
-static std::vector<GLuint> button_textures;
-
-GLuint starsTexture = 0, sunTexture = 0;
+#include "nbody.h"
+#include "labels.h"
+#include "telemetry.h"
+#include "trails.h"
+#include "texture_manager.h"
+#include "dynamic_resolution.h"
+
+static std::vector<TextureHandle> button_textures;
+static std::vector<Label> labels;
+static TrailBuffer planet_trails, particle_trails;
+static double trail_interval = 0.0, trail_sampled = NAN;
+static GLint scene_viewport[4] = {0, 0, 0, 0}; // Last drawScene() one, labels are placed in it
+
+GLfloat sunPhase = 0.0f;
+double days = 0.0;
+
+TextureHandle starsTexture = 0, sunTexture = 0;
 std::vector<Planet> planets;
+const Planet *selectedPlanet = NULL;
+NBody nbody;
 
 void drawAxes() {
     glLineWidth(3.0f);
@@ -58,13 +70,14 @@ void drawSun() {
     glRotatef(90.0f, 0.0f, 1.0f, 0.0f);
     glColor3f(1.0f, 1.0f, 0.0f);
     glRotatef(sunPhase, 0.0f, 1.0f, 0.0f);
-    glBindTexture(GL_TEXTURE_2D, sunTexture);
+    bindTexture(sunTexture);
 
     GLfloat emission[] = {3.0f, 3.0f, 0.0f, 0.7f};
     GLfloat zero_emission[] = {0.0f, 0.0f, 0.0f, 1.0f};
     glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, emission);
 
     GLUquadricObj *sun = gluNewQuadric();
+    telemetryCountGLCreate();
     gluQuadricDrawStyle(sun, GLU_FILL);
     gluQuadricTexture(sun, GLU_TRUE);
     gluQuadricNormals(sun, GLU_SMOOTH);
@@ -72,6 +85,7 @@ void drawSun() {
     gluSphere(sun, SUN_RADIUS, 50, 50);
 
     gluDeleteQuadric(sun);
+    telemetryCountGLDelete();
     glBindTexture(GL_TEXTURE_2D, 0);
     glMaterialfv(GL_FRONT_AND_BACK, GL_EMISSION, zero_emission);
 
@@ -80,9 +94,10 @@ void drawSun() {
 
 void drawSky() {
     glColor3f(1.0f, 1.0f, 1.0f);
-    glBindTexture(GL_TEXTURE_2D, starsTexture);
+    bindTexture(starsTexture);
 
     GLUquadricObj *stars = gluNewQuadric();
+    telemetryCountGLCreate();
     gluQuadricDrawStyle(stars, GLU_FILL);
     gluQuadricTexture(stars, GLU_TRUE);
     gluQuadricNormals(stars, GLU_SMOOTH);
@@ -90,6 +105,7 @@ void drawSky() {
     gluSphere(stars, ASTRONOMIC_UNIT * 10.0f, 50, 50);
 
     gluDeleteQuadric(stars);
+    telemetryCountGLDelete();
     glBindTexture(GL_TEXTURE_2D, 0);
 }
 
@@ -108,10 +124,12 @@ void drawText(const char *text, const TTF_Font *font, GLuint x, GLuint y, bool o
     }
 
     glGenTextures(1, &texture);
+    telemetryCountGLCreate();
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, text_surface->w, text_surface->h, 0, GL_BGRA, GL_UNSIGNED_BYTE, text_surface->pixels);
+    telemetryCountUpload(text_surface->w * text_surface->h * 4);
 
     glBegin(GL_QUADS);
     glTexCoord2d(0, 1); glVertex2i(x, y);
@@ -122,13 +140,14 @@ void drawText(const char *text, const TTF_Font *font, GLuint x, GLuint y, bool o
 
     glBindTexture(GL_TEXTURE_2D, 0);
     glDeleteTextures(1, &texture);
+    telemetryCountGLDelete();
     SDL_FreeSurface(text_surface);
 
 }
 
 
-void drawButton(GLuint texture, GLuint y) {
-    glBindTexture(GL_TEXTURE_2D, texture);
+void drawButton(TextureHandle texture, GLuint y) {
+    bindTexture(texture);
 
     glBegin(GL_QUADS);
     glTexCoord2d(0, 0); glVertex2i(10, y);
@@ -143,25 +162,28 @@ void drawButton(GLuint texture, GLuint y) {
 const char *elapsedDaysText = "Days elapsed: %.2f",
            *elapsedMonthsText = "Siderial months elapsed: %u",
            *fpsText = "FPS: %u",
+           *scaledFpsText = "FPS: %u, scene at %u%% resolution",
+           *telemetryText = "Last frame: %lu allocations (%llu bytes), GL objects +%lu/-%lu, %llu bytes uploaded",
            *aboutText[] = {
                "Simple Solar System model",
                "Controls:",
                " - w, a, s, d, z, x: camera movement",
                " - left, right, up, down, PgUp, PgDown: camera rotation",
+               " - right mouse button + mouse: look around",
                " - t: toggle speed acceleration by factor of 100",
                " - r: reset camera to initial position",
                " - o: orbits toggle",
+               " - l: trails toggle",
+               " - n: toggle N-body mode",
+               " - m: toggle allocation telemetry",
                " - f: toggle fullscreen",
                " - v: toggle VSync",
                " - h: this help",
                " - q: quit program",
                ""};
 
-void drawStats(const TTF_Font *font, Uint32 frames, bool help) {
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport); // [x, y, w, h]
-
-    // Temporaly set 2D projection and disable lights
+// Temporaly set 2D projection and disable lights
+static void begin2D(const GLint viewport[4]) {
     glMatrixMode(GL_PROJECTION);
     glPushMatrix();
     glLoadIdentity();
@@ -172,94 +194,280 @@ void drawStats(const TTF_Font *font, Uint32 frames, bool help) {
     glLoadIdentity();
 
     glDisable(GL_LIGHTING);
+}
+
+// Restore original matrices
+static void end2D() {
+    glPopMatrix();
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glEnable(GL_LIGHTING);
+}
+
+static void drawLabels(const TTF_Font *font, const GLint viewport[4]) {
+    labels.clear();
+    for (auto it = planets.begin(); it != planets.end(); it++)
+        it->collectTitles(labels, font, selectedPlanet);
+
+    // Scene may have been drawn at a lower resolution than the HUD
+    if (scene_viewport[2] && scene_viewport[3] && (scene_viewport[2] != viewport[2] || scene_viewport[3] != viewport[3]))
+        for (auto it = labels.begin(); it != labels.end(); it++) {
+            it->x = (GLint) ((GLfloat) (it->x - scene_viewport[0]) * viewport[2] / scene_viewport[2]) + viewport[0];
+            it->y = (GLint) ((GLfloat) (it->y - scene_viewport[1]) * viewport[3] / scene_viewport[3]) + viewport[1];
+        }
+    declutterLabels(labels, viewport[2], viewport[3]);
+    for (auto it = labels.begin(); it != labels.end(); it++)
+        drawText(it->text, font, it->x, it->y, true, true);
+}
+
+void drawStats(const TTF_Font *font, Uint32 frames, bool help, bool telemetry, bool labels) {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport); // [x, y, w, h]
 
+    begin2D(viewport);
 
     int days_len = snprintf(NULL, 0, elapsedDaysText, days) + 1;
-    char *days_str = (char*) malloc(days_len);
+    char *days_str = (char*) telemetryMalloc(days_len);
     snprintf(days_str, days_len, elapsedDaysText, days);
     drawText(days_str, font, 10, 20);
-    free(days_str);
+    telemetryFree(days_str);
 
-    GLuint months = floorf(days / SIDERIAL_MONTH);
+    GLuint months = floor(days / SIDERIAL_MONTH);
 
     int months_len = snprintf(NULL, 0, elapsedMonthsText, months) + 1;
-    char *months_str = (char*) malloc(months_len);
+    char *months_str = (char*) telemetryMalloc(months_len);
     snprintf(months_str, months_len, elapsedMonthsText, months);
     drawText(months_str, font, 10, 45);
-    free(months_str);
+    telemetryFree(months_str);
+
+    GLfloat scale = dynamicResolutionScale();
+    if (scale < 1.0f) {
+        char scaled_fps_str[64];
+        snprintf(scaled_fps_str, sizeof(scaled_fps_str), scaledFpsText, frames, (unsigned) (100 * scale + 0.5f));
+        drawText(scaled_fps_str, font, 10, 70);
+    } else {
+        int fps_len = snprintf(NULL, 0, fpsText, frames) + 1;
+        char *fps_str = (char*) telemetryMalloc(fps_len);
+        snprintf(fps_str, months_len, fpsText, frames);
+        drawText(fps_str, font, 10, 70);
+        telemetryFree(fps_str);
+    }
+
+    if (telemetry) {
+        TelemetryCounters last = telemetryLastFrame();
+        char telemetry_str[128];
+        snprintf(telemetry_str, sizeof(telemetry_str), telemetryText,
+                 last.allocations, last.allocated_bytes, last.gl_created, last.gl_deleted, last.upload_bytes);
+        drawText(telemetry_str, font, 10, viewport[3] - 5);
+    }
 
-    int fps_len = snprintf(NULL, 0, fpsText, frames) + 1;
-    char *fps_str = (char*) malloc(fps_len);
-    snprintf(fps_str, months_len, fpsText, frames);
-    drawText(fps_str, font, 10, 70);
-    free(fps_str);
+    if (labels)
+        drawLabels(font, viewport);
 
     Sint32 y1 = 79 + 50;
 
-    size_t i = 0;
-    for (auto it = planets.begin(); it != planets.end(); it++) {
-        it->showTitle(font);
-        drawButton(button_textures[i++], viewport[3] - y1);
+    for (size_t i = 0; i < buttonCount(); i++) {
+        drawButton(button_textures[i], viewport[3] - y1);
         y1 += 59;
     }
 
     if (help) {
-        // 266 and 362 are calculated for this particular font and text
+        // 366 and 362 are calculated for this particular font and text
         const char **aboutString = aboutText;
-        y1 = (viewport[3] - 266) / 2;
+        y1 = (viewport[3] - 366) / 2;
         while (**aboutString)
             drawText(*(aboutString++), font, (viewport[2] - 362) / 2, y1 += 25);
     }
 
-    // Restore original matrices
-    glPopMatrix();
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glEnable(GL_LIGHTING);
+    end2D();
+}
+
+// Overlay for offscreen snapshots: no buttons, FPS or help
+void drawSnapshotOverlay(const TTF_Font *font, bool labels, bool date) {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport); // [x, y, w, h]
+
+    begin2D(viewport);
+
+    if (date) {
+        char days_str[64];
+        snprintf(days_str, sizeof(days_str), elapsedDaysText, days);
+        drawText(days_str, font, 10, 20);
+    }
+
+    if (labels)
+        drawLabels(font, viewport);
+
+    end2D();
 }
 
 void initPlanets() {
-    //                       Radius               A                        Ecc    Year    Day      Incl   Tilt    Node    Perih.  Texture                 Phase  Name
-    planets.push_back(Planet(EARTH_RADIUS * 0.38, ASTRONOMIC_UNIT * 0.39f, 0.2f,  87.9f,  58.6f,   7.0f,  0.03f,  48.33f, 29.12f, "textures/mercury.bmp", -M_PI, "Mercury"));
-    planets.push_back(Planet(EARTH_RADIUS * 0.93, ASTRONOMIC_UNIT * 0.7f,  0.006f,224.7f, -243.0f, 3.39f, 177.3f, 76.67f, 55.18f, "textures/venus.bmp",   -M_PI, "Venus"));
-
-    planets.push_back(Planet(EARTH_RADIUS, ASTRONOMIC_UNIT, 0.016f, SIDERIAL_YEAR, 1.0f, 0.0f, EARTH_AXIS_INCLINATION, 0.0f, 0.0f, "textures/earth.bmp", -M_PI, "Earth"));
-    planets.back().addMoon(Planet(MOON_RADIUS, MOON_ORBIT_RADIUS, 0.05f, SIDERIAL_MONTH, SIDERIAL_MONTH, MOON_INCLINATION, 6.68f, 0.0f, 0.0f, "textures/moon.bmp", 0.0f, "Moon"));
-
-    planets.push_back(Planet(EARTH_RADIUS * 0.53, ASTRONOMIC_UNIT * 1.52f, 0.09f, 686.9f, 1.02f,   1.85f, 25.19f, 49.5f,  286.5,  "textures/mars.bmp",    -M_PI, "Mars"));
-
-    planets.push_back(Planet(EARTH_RADIUS * 11.0f,ASTRONOMIC_UNIT * 5.2f,  0.04f, 4332.5f,0.41f,   1.3f,  3.13f,  100.4f, 275.0f, "textures/jupiter.bmp", -M_PI, "Jupiter"));
-    planets.back().addMoon(Planet(EARTH_RADIUS * 0.28f, ASTRONOMIC_UNIT * 0.002f, 0.004f, 1.8f, 1.8f, 0.05f, 0.0f, 0.0f, 0.0f, "textures/io.bmp", 0.0f, "Io"));
-    planets.back().addMoon(Planet(EARTH_RADIUS * 0.245f, ASTRONOMIC_UNIT * 0.0044f, 0.009f, 3.55f, 3.55f, 0.47f, 0.1f, 0.0f, 0.0f, "textures/europa.bmp", 0.0f, "Europa"));
-    planets.back().addMoon(Planet(EARTH_RADIUS * 0.413f, ASTRONOMIC_UNIT * 0.00715, 0.0013f, 7.15f, 7.15f, 0.2f, 0.3f, 0.0f, 0.0f, "textures/ganymede.bmp", 0.0f, "Ganymede"));
-    planets.back().addMoon(Planet(EARTH_RADIUS * 0.378f, ASTRONOMIC_UNIT * 0.01259f, 0.007f, 16.69f, 16.69f, 0.192f, 0.0f, 0.0f, 0.0f, "textures/callisto.bmp", 0.0f, "Callisto"));
-
-    button_textures.push_back(loadBMPTexture("textures/buttons/mercury.bmp"));
-    button_textures.push_back(loadBMPTexture("textures/buttons/venus.bmp"));
-    button_textures.push_back(loadBMPTexture("textures/buttons/earth.bmp"));
-    button_textures.push_back(loadBMPTexture("textures/buttons/mars.bmp"));
-    button_textures.push_back(loadBMPTexture("textures/buttons/jupiter.bmp"));
+    //                       Radius               A                        Ecc    Year    Day      Incl   Tilt    Node    Perih.  Texture                 Phase  Name       Mass
+    planets.push_back(Planet(EARTH_RADIUS * 0.38, ASTRONOMIC_UNIT * 0.39f, 0.2f,  87.9f,  58.6f,   7.0f,  0.03f,  48.33f, 29.12f, "textures/mercury.bmp", -M_PI, "Mercury", 1.66e-7f));
+    planets.push_back(Planet(EARTH_RADIUS * 0.93, ASTRONOMIC_UNIT * 0.7f,  0.006f,224.7f, -243.0f, 3.39f, 177.3f, 76.67f, 55.18f, "textures/venus.bmp",   -M_PI, "Venus",   2.45e-6f));
+
+    planets.push_back(Planet(EARTH_RADIUS, ASTRONOMIC_UNIT, 0.016f, SIDERIAL_YEAR, 1.0f, 0.0f, EARTH_AXIS_INCLINATION, 0.0f, 0.0f, "textures/earth.bmp", -M_PI, "Earth", 3.0e-6f));
+    planets.back().addMoon(Planet(MOON_RADIUS, MOON_ORBIT_RADIUS, 0.05f, SIDERIAL_MONTH, SIDERIAL_MONTH, MOON_INCLINATION, 6.68f, 0.0f, 0.0f, "textures/moon.bmp", 0.0f, "Moon", 3.69e-8f));
+
+    planets.push_back(Planet(EARTH_RADIUS * 0.53, ASTRONOMIC_UNIT * 1.52f, 0.09f, 686.9f, 1.02f,   1.85f, 25.19f, 49.5f,  286.5,  "textures/mars.bmp",    -M_PI, "Mars",    3.23e-7f));
+
+    planets.push_back(Planet(EARTH_RADIUS * 11.0f,ASTRONOMIC_UNIT * 5.2f,  0.04f, 4332.5f,0.41f,   1.3f,  3.13f,  100.4f, 275.0f, "textures/jupiter.bmp", -M_PI, "Jupiter", 9.55e-4f));
+    planets.back().addMoon(Planet(EARTH_RADIUS * 0.28f, ASTRONOMIC_UNIT * 0.002f, 0.004f, 1.8f, 1.8f, 0.05f, 0.0f, 0.0f, 0.0f, "textures/io.bmp", 0.0f, "Io", 4.49e-8f));
+    planets.back().addMoon(Planet(EARTH_RADIUS * 0.245f, ASTRONOMIC_UNIT * 0.0044f, 0.009f, 3.55f, 3.55f, 0.47f, 0.1f, 0.0f, 0.0f, "textures/europa.bmp", 0.0f, "Europa", 2.41e-8f));
+    planets.back().addMoon(Planet(EARTH_RADIUS * 0.413f, ASTRONOMIC_UNIT * 0.00715, 0.0013f, 7.15f, 7.15f, 0.2f, 0.3f, 0.0f, 0.0f, "textures/ganymede.bmp", 0.0f, "Ganymede", 7.45e-8f));
+    planets.back().addMoon(Planet(EARTH_RADIUS * 0.378f, ASTRONOMIC_UNIT * 0.01259f, 0.007f, 16.69f, 16.69f, 0.192f, 0.0f, 0.0f, 0.0f, "textures/callisto.bmp", 0.0f, "Callisto", 5.41e-8f));
+
+    button_textures.push_back(acquireTexture("textures/buttons/mercury.bmp"));
+    button_textures.push_back(acquireTexture("textures/buttons/venus.bmp"));
+    button_textures.push_back(acquireTexture("textures/buttons/earth.bmp"));
+    button_textures.push_back(acquireTexture("textures/buttons/mars.bmp"));
+    button_textures.push_back(acquireTexture("textures/buttons/jupiter.bmp"));
+}
+
+// Generated scenes have no buttons, the Solar system has one for every planet
+size_t buttonCount() {
+    return button_textures.size() < planets.size() ? button_textures.size() : planets.size();
 }
 
 void freeTextures() {
     for (auto it = button_textures.begin(); it != button_textures.end(); it++)
-        glDeleteTextures(1, &(*it));
+        releaseTexture(*it);
+    button_textures.clear();
 }
 
-void drawPlanets(bool orbits) {
+void drawPlanets(bool orbits, bool particles) {
     for (auto it = planets.begin(); it != planets.end(); it++)
         it->render(orbits);
+
+    if (particles)
+        nbody.render();
 }
 
-void physicsStep(int elapsed) {
-    for (auto it = planets.begin(); it != planets.end(); it++)
-        it->physicsStep(elapsed);
+size_t countBodies(const std::vector<Planet> &bodies) {
+    size_t count = bodies.size();
+    for (auto it = bodies.begin(); it != bodies.end(); it++)
+        count += countBodies(it->getMoons());
+    return count;
+}
+
+// Planets are followed by their moons, until there is no more room before end
+static GLfloat *trailPositions(const std::vector<Planet> &bodies, const GLfloat *parent, GLfloat *out, const GLfloat *end) {
+    GLfloat mat[16];
+    for (auto it = bodies.begin(); it != bodies.end() && out != end; it++) {
+        it->bodyFrame(mat, parent);
+        *(out++) = mat[12];
+        *(out++) = mat[13];
+        *(out++) = mat[14];
+        out = trailPositions(it->getMoons(), mat, out, end);
+    }
+    return out;
+}
+
+// History of the last span_days days, planets and moons are one class of bodies and N-body particles another
+void initTrails(double span_days) {
+    trail_interval = span_days / TRAIL_SAMPLES;
+    trail_sampled = NAN;
+    size_t bodies = countBodies(planets);
+    planet_trails.allocate(bodies < TRAIL_MAX_BODIES ? bodies : TRAIL_MAX_BODIES, TRAIL_SAMPLES);
+    particle_trails.allocate(nbody.size() < TRAIL_MAX_BODIES ? nbody.size() : TRAIL_MAX_BODIES, TRAIL_SAMPLES);
+}
+
+void sampleTrails(bool particles) {
+    if (!trail_interval || days - trail_sampled < trail_interval)
+        return;
+
+    // Time jumped back or far ahead, old history does not lead here
+    if (days < trail_sampled || days - trail_sampled > TRAIL_SAMPLES * trail_interval) {
+        planet_trails.clear();
+        particle_trails.clear();
+    }
+    trail_sampled = days;
+
+    if (GLfloat *out = planet_trails.beginAppend()) {
+        trailPositions(planets, NULL, out, out + 3 * planet_trails.bodies());
+        planet_trails.endAppend();
+    }
+
+    // Particles only move in N-body mode, their trails stay where they were otherwise
+    GLfloat *out = particles ? particle_trails.beginAppend() : NULL;
+    if (out) {
+        const std::vector<Particle> &source = nbody.getParticles();
+        for (size_t i = 0; i < particle_trails.bodies(); i++) {
+            *(out++) = source[i].x;
+            *(out++) = source[i].y;
+            *(out++) = source[i].z;
+        }
+        particle_trails.endAppend();
+    }
+}
+
+void drawTrails(bool particles) {
+    planet_trails.render(0.4f, 0.7f, 1.0f);
+    if (particles)
+        particle_trails.render(0.7f, 0.7f, 0.6f);
+}
+
+void freeTrails() {
+    planet_trails.release();
+    particle_trails.release();
+}
+
+void setPerspective(int width, int height, GLfloat fov) {
+    if (!height)
+        height = 1;
+
+    glViewport(0, 0, (GLint) width, (GLint) height);
+
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+
+    gluPerspective(fov, (float) width/height,  0.1f / ASTRONOMIC_UNIT, ASTRONOMIC_UNIT * 50.0f);
+
+    glMatrixMode(GL_MODELVIEW);
+}
+
+// Camera is [position, sight, up]
+void beginScene(const GLfloat camera[9]) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glLoadIdentity();
+
+    gluLookAt(camera[0],             camera[1],             camera[2],
+              camera[0] + camera[3], camera[1] + camera[4], camera[2] + camera[5],
+              camera[6],             camera[7],             camera[8]);
+
+    GLfloat sun_p[] = {0.0f, 0.0f, 0.0f, 1.0f};
+    glLightfv(GL_LIGHT0, GL_POSITION, sun_p);
+}
+
+void drawScene(const GLfloat camera[9], bool orbits, bool particles, bool trails) {
+    glGetIntegerv(GL_VIEWPORT, scene_viewport);
+    beginScene(camera);
+
+    //drawAxes();
+    drawSky();
+
+    drawSun();
+    drawPlanets(orbits, particles);
+    if (trails)
+        drawTrails(particles);
+}
+
+// Jump to arbitrary simulation time, planets follow lazily
+void setSimulationTime(double t) {
+    days = t;
+    sunPhase = fmod(360 * days / SUN_SIDERIAL_PERIOD, 360.0);
+}
+
+/*
+ * Only the clock moves here: planets work out their state from it when
+ * something (rendering, labels, picking, N-body) asks for it.
+ */
+void physicsStep(int elapsed, bool nbody_mode) {
+    setSimulationTime(days + DAYS_PER_SECOND * elapsed / 1000.0);
 
-    days += DAYS_PER_SECOND / FPS;
+    if (nbody_mode) // Lazily evaluated planets are already at the end of the step, as the closing kick needs
+        nbody.step(DAYS_PER_SECOND * elapsed / 1000.0, planets);
 
-    // Sun rotation
-    sunPhase += 360 * DAYS_PER_SECOND * elapsed / (1000 * SUN_SIDERIAL_PERIOD);
-    if (sunPhase > 360)
-        sunPhase -= 360;
+    sampleTrails(nbody_mode);
 }
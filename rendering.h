@@ -6,11 +6,18 @@
 #include <SDL_ttf.h>
 
 #include "planet.h"
+#include "nbody.h"
+#include "texture_manager.h"
 
-extern GLuint starsTexture;
-extern GLuint sunTexture;
+extern TextureHandle starsTexture;
+extern TextureHandle sunTexture;
+
+extern GLfloat sunPhase;
+extern double days; // Simulation time
 
 extern std::vector<Planet> planets;
+extern const Planet *selectedPlanet; // Last one chosen with a button, its label always wins
+extern NBody nbody;
 
 void drawAxes();
 void drawEcliptic();
@@ -18,12 +25,24 @@ void drawSun();
 void drawEarth();
 void drawMoon();
 void drawSky();
-void drawStats(const TTF_Font *font, Uint32 frames, bool help = false);
+void drawStats(const TTF_Font *font, Uint32 frames, bool help = false, bool telemetry = false, bool labels = true);
+void drawSnapshotOverlay(const TTF_Font *font, bool labels = true, bool date = true);
 void initPlanets();
-void drawPlanets(bool orbits = false);
-void physicsStep(int elapsed);
+size_t countBodies(const std::vector<Planet> &bodies); // Moons included
+size_t buttonCount(); // Planets that can be selected with a button, the first ones
+void drawPlanets(bool orbits = false, bool particles = false);
+void setPerspective(int width, int height, GLfloat fov = 45.0f); // Viewport and projection for a target of this size, fov is vertical, degrees
+void beginScene(const GLfloat camera[9]); // Clears the target, sets up the camera and the Sun's light
+void drawScene(const GLfloat camera[9], bool orbits = false, bool particles = false, bool trails = false);
+void setSimulationTime(double t);
+void physicsStep(int elapsed, bool nbody_mode = false);
 void freeTextures();
 
+void initTrails(double span_days); // Needs planets and N-body particles in place
+void sampleTrails(bool particles);
+void drawTrails(bool particles);
+void freeTrails();
+
 void drawText(const char *text, const TTF_Font *font, GLuint x, GLuint y, bool opengl_coordinates = false, bool center_coordinates = false);
 
 #endif
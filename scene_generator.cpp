@@ -0,0 +1,90 @@
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#define snprintf _snprintf
+#define _USE_MATH_DEFINES
+#endif
+#include <math.h>
+#include <stdio.h>
+#include <GL/gl.h>
+
+#include <deque>
+#include <random>
+#include <string>
+
+#include "constants.h"
+#include "scene_generator.h"
+
+#define EARTH_MASS 3.0e-6 // Solar masses
+#define HILL_FRACTION 0.4 // Prograde moons are stable up to about half of the Hill radius
+
+static const char *planet_texture_files[] = {"textures/mercury.bmp", "textures/venus.bmp", "textures/earth.bmp", "textures/mars.bmp", "textures/jupiter.bmp"};
+static const char *moon_texture_files[] = {"textures/moon.bmp", "textures/io.bmp", "textures/europa.bmp", "textures/ganymede.bmp", "textures/callisto.bmp"};
+
+static std::deque<std::string> names; // Bodies keep pointers, a deque never moves its elements
+
+static const char *nextName(size_t &labels, const std::string &name) {
+    if (!labels)
+        return "";
+    labels--;
+    names.push_back(name);
+    return names.back().c_str();
+}
+
+void generatePlanets(std::vector<Planet> &planets, unsigned seed, size_t planet_count, size_t moons_per_planet, size_t labels) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0), angle(0.0, 360.0), phi(-M_PI, M_PI);
+    std::uniform_int_distribution<size_t> planet_texture(0, sizeof(planet_texture_files) / sizeof(*planet_texture_files) - 1);
+    std::uniform_int_distribution<size_t> moon_texture(0, sizeof(moon_texture_files) / sizeof(*moon_texture_files) - 1);
+
+    // Log-uniform, as spacing and sizes of real planets are closer to that than to anything linear
+    auto logUniform = [&](double low, double high) { return low * pow(high / low, uniform(rng)); };
+
+    planets.reserve(planets.size() + planet_count);
+    for (size_t i = 0; i < planet_count; i++) {
+        // One draw per statement, order of evaluation of function arguments is unspecified
+        double a = logUniform(GENERATOR_MIN_AXIS, GENERATOR_MAX_AXIS); // AU
+        double radius = logUniform(GENERATOR_MIN_RADIUS, GENERATOR_MAX_RADIUS); // Earth radii
+        double mass = EARTH_MASS * pow(radius, 2.4); // Fits Mercury to Jupiter within a factor of two
+        double year = SIDERIAL_YEAR * pow(a, 1.5);
+        double day = logUniform(0.4, 250.0);
+        if (uniform(rng) < 0.1)
+            day = -day; // Some spin backwards, like Venus
+        double tilt = 30.0 * uniform(rng);
+        double eccentricity = 0.1 * uniform(rng), inclination = 7.0 * uniform(rng);
+        double node = angle(rng), periapsis = angle(rng), initial_phi = phi(rng);
+        const char *texture = planet_texture_files[planet_texture(rng)];
+
+        char name[32];
+        snprintf(name, sizeof(name), "P%lu", (unsigned long) i + 1);
+
+        planets.push_back(Planet(EARTH_RADIUS * radius, ASTRONOMIC_UNIT * a, eccentricity, year, day, inclination, tilt,
+                                 node, periapsis, texture, initial_phi, nextName(labels, name), mass));
+        Planet &planet = planets.back();
+
+        double hill = a * cbrt(mass / 3.0);
+        double min_axis = GENERATOR_MOON_MIN_AXIS * radius * EARTH_RADIUS / ASTRONOMIC_UNIT;
+        double max_axis = fmax(HILL_FRACTION * hill, 2.0 * min_axis);
+
+        for (size_t j = 0; j < moons_per_planet; j++) {
+            double moon_a = logUniform(min_axis, max_axis);
+            double moon_radius = radius * logUniform(0.02, 0.3);
+            double moon_year = SIDERIAL_YEAR * sqrt(moon_a * moon_a * moon_a / mass);
+            double moon_eccentricity = 0.05 * uniform(rng), moon_inclination = 5.0 * uniform(rng), moon_tilt = 5.0 * uniform(rng);
+            double moon_node = angle(rng), moon_periapsis = angle(rng), moon_phi = phi(rng);
+            const char *moon_texture_file = moon_texture_files[moon_texture(rng)];
+
+            char moon_name[64];
+            snprintf(moon_name, sizeof(moon_name), "%s/%lu", name, (unsigned long) j + 1);
+
+            // Tidally locked, like nearly every big moon
+            planet.addMoon(Planet(EARTH_RADIUS * moon_radius, ASTRONOMIC_UNIT * moon_a, moon_eccentricity, moon_year, moon_year,
+                                  moon_inclination, moon_tilt, moon_node, moon_periapsis, moon_texture_file, moon_phi,
+                                  nextName(labels, moon_name), EARTH_MASS * pow(moon_radius, 2.4)));
+        }
+    }
+}
+
+void freeGeneratedScene() {
+    std::deque<std::string>().swap(names);
+}
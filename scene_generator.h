@@ -0,0 +1,36 @@
+
+#ifndef SCENE_GENERATOR_H
+#define SCENE_GENERATOR_H
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "planet.h"
+
+#define GENERATOR_PLANETS 8          // Defaults for the command line
+#define GENERATOR_MOONS 2
+#define GENERATOR_MIN_AXIS 0.3       // Planet semimajor axes, AU
+#define GENERATOR_MAX_AXIS 40.0
+#define GENERATOR_MIN_RADIUS 0.3     // Planet radii, Earth radii
+#define GENERATOR_MAX_RADIUS 12.0
+#define GENERATOR_MOON_MIN_AXIS 3.0  // Moon semimajor axes, radii of their planet
+
+/*
+ * Synthetic planetary systems for scaling and stress tests, in place of
+ * initPlanets(). Orbital elements are drawn from a generator seeded with
+ * `seed`, so the same arguments give the same scene on every run: semimajor
+ * axes log-uniform between GENERATOR_MIN_AXIS and GENERATOR_MAX_AXIS, periods
+ * by Kepler's third law, eccentricities and inclinations within what the
+ * Solar system has, masses from radii. Moons orbit within their planet's Hill
+ * sphere.
+ *
+ * Bodies share a handful of textures, loaded once by the texture manager, so
+ * a million of them cost no more texture memory than nine. Only the first
+ * `labels` bodies (planets followed by their moons) get names, the rest are
+ * drawn without a label.
+ */
+void generatePlanets(std::vector<Planet> &planets, unsigned seed, size_t planet_count, size_t moons_per_planet, size_t labels);
+void freeGeneratedScene(); // Names, after the bodies are gone
+
+#endif
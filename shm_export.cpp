@@ -0,0 +1,133 @@
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+#include "shm_export.h"
+
+#ifndef _WIN32
+
+static ShmHeader *header = NULL;
+static char shm_name[256];
+static uint64_t tick = 0;
+
+bool shmExportOpen(const char *name) {
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd < 0) {
+        perror("Cannot create shared memory segment");
+        return false;
+    }
+
+    if (ftruncate(fd, sizeof(ShmHeader)) < 0) {
+        perror("Cannot resize shared memory segment");
+        close(fd);
+        return false;
+    }
+
+    void *mem = mmap(NULL, sizeof(ShmHeader), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        perror("Cannot map shared memory segment");
+        return false;
+    }
+
+    header = (ShmHeader*) mem;
+    header->magic.store(0, std::memory_order_relaxed);
+    header->version = SHM_VERSION;
+    header->slot_count = SHM_SLOTS;
+    header->max_bodies = SHM_MAX_BODIES;
+    header->latest.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < SHM_SLOTS; i++) {
+        header->frames[i].sequence.store(0, std::memory_order_relaxed);
+        header->frames[i].tick = 0;
+        header->frames[i].body_count = 0;
+    }
+    header->magic.store(SHM_MAGIC, std::memory_order_release);
+
+    snprintf(shm_name, sizeof(shm_name), "%s", name);
+    tick = 0;
+
+    return true;
+}
+
+static void publishBody(ShmFrame &frame, const Planet &planet, const GLfloat *parent) {
+    if (frame.body_count >= SHM_MAX_BODIES)
+        return; // Full, neither this body nor its moons fit
+
+    GLfloat mat[16];
+    planet.bodyFrame(mat, parent);
+
+    ShmBody &body = frame.bodies[frame.body_count++];
+    strncpy(body.name, planet.getName(), SHM_NAME_LENGTH - 1);
+    body.name[SHM_NAME_LENGTH - 1] = '\0';
+    body.x = mat[12];
+    body.y = mat[13];
+    body.z = mat[14];
+    body.phase = planet.getPhase();
+
+    const std::vector<Planet> &moons = planet.getMoons();
+    for (auto it = moons.begin(); it != moons.end(); it++)
+        publishBody(frame, *it, mat);
+}
+
+void shmExportPublish(const std::vector<Planet> &planets, double days, GLfloat sun_phase, const GLfloat camera[9]) {
+    if (!header)
+        return;
+
+    tick++;
+    ShmFrame &frame = header->frames[tick % SHM_SLOTS];
+
+    uint32_t sequence = frame.sequence.load(std::memory_order_relaxed);
+    frame.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    frame.tick = tick;
+    frame.days = days;
+    memcpy(frame.camera, camera, sizeof(frame.camera));
+
+    ShmBody &sun = frame.bodies[0];
+    strncpy(sun.name, "Sun", SHM_NAME_LENGTH);
+    sun.x = sun.y = sun.z = 0.0f;
+    sun.phase = sun_phase;
+    frame.body_count = 1;
+
+    for (auto it = planets.begin(); it != planets.end() && frame.body_count < SHM_MAX_BODIES; it++)
+        publishBody(frame, *it, NULL);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    frame.publish_ns = (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+
+    frame.sequence.store(sequence + 2, std::memory_order_release);
+    header->latest.store(tick, std::memory_order_release);
+}
+
+void shmExportClose() {
+    if (!header)
+        return;
+
+    munmap(header, sizeof(ShmHeader));
+    shm_unlink(shm_name);
+    header = NULL;
+}
+
+#else
+
+bool shmExportOpen(const char *) {
+    fprintf(stderr, "Shared memory export is not supported on this platform\n");
+    return false;
+}
+
+void shmExportPublish(const std::vector<Planet> &, double, GLfloat, const GLfloat *) {
+}
+
+void shmExportClose() {
+}
+
+#endif
@@ -0,0 +1,85 @@
+
+#ifndef SHM_EXPORT_H
+#define SHM_EXPORT_H
+
+#include <stdint.h>
+
+#include <atomic>
+
+/*
+ * Layout of the shared-memory segment the simulator publishes every physics
+ * tick to (see --shm). Only plain fixed-size types are used, so readers need
+ * nothing but this header.
+ *
+ * Frames form a ring of SHM_SLOTS entries, each guarded by its own sequence
+ * counter: it is odd while the writer is inside the frame and even otherwise.
+ * A reader takes `latest`, reads that frame in place and accepts it only if
+ * the sequence was even and did not change meanwhile. The writer never waits
+ * for readers, and a slot is only rewritten SHM_SLOTS ticks later, so in
+ * practice the first attempt always succeeds.
+ */
+
+#define SHM_MAGIC 0x52414c53 // "SLAR"
+#define SHM_VERSION 1
+#define SHM_SLOTS 8
+#define SHM_MAX_BODIES 64
+#define SHM_NAME_LENGTH 16
+
+struct ShmBody {
+    char name[SHM_NAME_LENGTH];
+    float x, y, z;  // Scene units, 1 AU is ASTRONOMIC_UNIT
+    float phase;    // Rotation about own axis, degrees
+};
+
+struct ShmFrame {
+    std::atomic<uint32_t> sequence;
+    uint32_t body_count;
+    uint64_t tick;
+    uint64_t publish_ns;  // CLOCK_MONOTONIC at publication, for latency measurements
+    double days;          // Simulation time
+    float camera[9];      // Position, sight and up vectors
+    ShmBody bodies[SHM_MAX_BODIES]; // bodies[0] is the Sun
+};
+
+struct ShmHeader {
+    std::atomic<uint32_t> magic; // Written last, once the segment is initialized
+    uint32_t version;
+    uint32_t slot_count;
+    uint32_t max_bodies;
+    std::atomic<uint64_t> latest; // Tick number of the newest complete frame
+    ShmFrame frames[SHM_SLOTS];
+};
+
+/*
+ * Zero-copy read of a frame: remember shmBeginRead(), use the frame right in
+ * the shared memory, then discard whatever was derived from it unless
+ * shmEndRead() succeeds.
+ */
+inline uint32_t shmBeginRead(const ShmFrame &frame) {
+    return frame.sequence.load(std::memory_order_acquire);
+}
+
+inline bool shmEndRead(const ShmFrame &frame, uint32_t sequence) {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return !(sequence & 1) && frame.sequence.load(std::memory_order_relaxed) == sequence;
+}
+
+#ifndef SHM_READER_ONLY
+
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+#include <vector>
+
+#include "planet.h"
+
+bool shmExportOpen(const char *name); // POSIX shm name, e.g. "/solar"
+void shmExportPublish(const std::vector<Planet> &planets, double days, GLfloat sun_phase, const GLfloat camera[9]);
+void shmExportClose();
+
+#endif
+
+#endif
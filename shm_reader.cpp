@@ -0,0 +1,107 @@
+/*
+ * Example consumer of the state published by `solar --shm NAME`. Follows the
+ * newest frame, prints body positions once a second together with
+ * publish-to-read latency statistics, and exits after the given number of
+ * frames (or never, if it is 0).
+ *
+ * Usage: shm_reader NAME [FRAMES]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SHM_READER_ONLY
+#include "shm_export.h"
+
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s NAME [FRAMES]\n", argv[0]);
+        return 1;
+    }
+    unsigned long limit = argc > 2 ? strtoul(argv[2], NULL, 10) : 0;
+
+    int fd = shm_open(argv[1], O_RDONLY, 0);
+    if (fd < 0) {
+        perror("Cannot open shared memory segment");
+        return 1;
+    }
+
+    void *mem = mmap(NULL, sizeof(ShmHeader), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        perror("Cannot map shared memory segment");
+        return 1;
+    }
+
+    const ShmHeader *header = (const ShmHeader*) mem;
+    while (header->magic.load(std::memory_order_acquire) != SHM_MAGIC)
+        usleep(1000);
+    if (header->version != SHM_VERSION || header->slot_count != SHM_SLOTS || header->max_bodies != SHM_MAX_BODIES) {
+        fprintf(stderr, "Incompatible shared memory layout\n");
+        return 1;
+    }
+
+    uint64_t last = header->latest.load(std::memory_order_acquire);
+    uint64_t report_at = now_ns() + 1000000000;
+    uint64_t latency_min = UINT64_MAX, latency_max = 0, latency_sum = 0;
+    unsigned long frames = 0, samples = 0, retries = 0, missed = 0;
+
+    while (!limit || frames < limit) {
+        uint64_t tick = header->latest.load(std::memory_order_acquire);
+        if (tick == last) {
+            usleep(50);
+            continue;
+        }
+        if (last && tick > last + 1)
+            missed += tick - last - 1;
+
+        const ShmFrame &frame = header->frames[tick % SHM_SLOTS];
+        uint32_t sequence = shmBeginRead(frame);
+
+        uint64_t latency = now_ns() - frame.publish_ns;
+        bool report = now_ns() >= report_at;
+        if (report) {
+            // Printing straight from shared memory is fine: worst case we print a torn line
+            printf("tick %llu, day %.4f\n", (unsigned long long) frame.tick, frame.days);
+            for (uint32_t i = 0; i < frame.body_count && i < SHM_MAX_BODIES; i++)
+                printf("  %-12.*s %10.4f %10.4f %10.4f  phase %7.2f\n", SHM_NAME_LENGTH, frame.bodies[i].name,
+                       frame.bodies[i].x, frame.bodies[i].y, frame.bodies[i].z, frame.bodies[i].phase);
+        }
+
+        if (!shmEndRead(frame, sequence) || frame.tick != tick) {
+            retries++;
+            continue;
+        }
+
+        last = tick;
+        frames++;
+        samples++;
+        latency_sum += latency;
+        if (latency < latency_min)
+            latency_min = latency;
+        if (latency > latency_max)
+            latency_max = latency;
+
+        if (report) {
+            printf("latency: min %.1f us, avg %.1f us, max %.1f us over %lu frames; %lu retries, %lu frames missed\n",
+                   latency_min / 1000.0, latency_sum / 1000.0 / samples, latency_max / 1000.0, samples, retries, missed);
+            latency_min = UINT64_MAX;
+            latency_max = latency_sum = 0;
+            samples = 0;
+            report_at = now_ns() + 1000000000;
+        }
+    }
+
+    munmap(mem, sizeof(ShmHeader));
+    return 0;
+}
@@ -0,0 +1,227 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "snapshot.h"
+
+#ifdef _MSC_VER
+#define snprintf _snprintf
+#endif
+
+#define SNAPSHOT_BYTE_ORDER 0x01020304 // Reads differently on a machine of the other endianness
+
+#define SNAPSHOT_ORBITS 1
+#define SNAPSHOT_NBODY 2
+#define SNAPSHOT_TRAILS 4
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t byte_order;
+    uint32_t particle_size;
+    uint32_t flags;
+    uint32_t bodies; // Planets and moons of the scene it was taken in
+    uint32_t seed;   // Generator seed of that scene, 0 for the Solar system
+    uint32_t unused; // Keeps the rest aligned alike everywhere
+    double days;
+    GLfloat camera[9];
+    int32_t speed_factor;
+    uint64_t particle_count;
+};
+static_assert(sizeof(SnapshotHeader) == 88, "Snapshot header layout changed, bump SNAPSHOT_VERSION");
+
+static const char snapshot_magic[4] = {'S', 'O', 'L', 'S'};
+
+// Writer thread and the checkpoint it is handed
+static std::mutex writer_mutex;
+static std::condition_variable writer_wake, writer_idle;
+static std::thread writer;
+static std::vector<unsigned char> image; // Kept between checkpoints, so taking one does not allocate
+static std::string image_path;
+static bool image_pending = false, writer_quit = false;
+
+static void serialize(const SnapshotState &state, const NBody &nbody, size_t bodies, unsigned seed) {
+    const std::vector<Particle> &particles = nbody.getParticles();
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, snapshot_magic, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.particle_size = sizeof(Particle);
+    header.flags = (state.orbits ? SNAPSHOT_ORBITS : 0) | (state.nbody_mode ? SNAPSHOT_NBODY : 0) |
+                   (state.trails ? SNAPSHOT_TRAILS : 0);
+    header.bodies = bodies;
+    header.seed = seed;
+    header.days = state.days;
+    memcpy(header.camera, state.camera, sizeof(header.camera));
+    header.speed_factor = state.speed_factor;
+    header.particle_count = particles.size();
+
+    image.resize(sizeof(header) + particles.size() * sizeof(Particle));
+    memcpy(&image[0], &header, sizeof(header));
+    if (!particles.empty())
+        memcpy(&image[sizeof(header)], &particles[0], particles.size() * sizeof(Particle));
+}
+
+// Temporary file first, then rename, so the old snapshot stays intact until the new one is complete
+static bool writeImage(const char *path) {
+    char temp_path[4096];
+    snprintf(temp_path, sizeof(temp_path), "%s.tmp", path);
+
+    FILE *file = fopen(temp_path, "wb");
+    if (!file) {
+        perror("Cannot write snapshot");
+        return false;
+    }
+
+    bool written = fwrite(&image[0], 1, image.size(), file) == image.size() && fflush(file) == 0;
+#ifdef _WIN32
+    written = written && _commit(_fileno(file)) == 0;
+#else
+    written = written && fsync(fileno(file)) == 0; // Data must be on disk before the name points to it
+#endif
+    written = fclose(file) == 0 && written;
+
+    if (!written) {
+        perror("Cannot write snapshot");
+        remove(temp_path);
+        return false;
+    }
+
+#ifdef _WIN32
+    if (!MoveFileExA(temp_path, path, MOVEFILE_REPLACE_EXISTING)) {
+        fprintf(stderr, "Cannot replace snapshot %s\n", path);
+#else
+    if (rename(temp_path, path) < 0) {
+        perror("Cannot replace snapshot");
+#endif
+        remove(temp_path);
+        return false;
+    }
+
+    return true;
+}
+
+static void writerLoop() {
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    while (true) {
+        writer_wake.wait(lock, [] { return image_pending || writer_quit; });
+        if (!image_pending)
+            return;
+
+        // Nobody touches the image while it is pending
+        lock.unlock();
+        writeImage(image_path.c_str());
+        lock.lock();
+
+        image_pending = false;
+        writer_idle.notify_all();
+    }
+}
+
+bool snapshotLoad(const char *path, SnapshotState &state, NBody &nbody, size_t bodies, unsigned seed) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        if (errno != ENOENT) // No snapshot yet is fine
+            perror("Cannot open snapshot");
+        return false;
+    }
+
+    SnapshotHeader header;
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, snapshot_magic, sizeof(header.magic))) {
+        fprintf(stderr, "%s is not a snapshot\n", path);
+        fclose(file);
+        return false;
+    }
+
+    if (header.version != SNAPSHOT_VERSION || header.byte_order != SNAPSHOT_BYTE_ORDER || header.particle_size != sizeof(Particle)) {
+        fprintf(stderr, "Snapshot %s was written by an incompatible version or machine\n", path);
+        fclose(file);
+        return false;
+    }
+
+    if (header.bodies != bodies || header.seed != seed) {
+        fprintf(stderr, "Snapshot %s is of a scene with %u bodies from seed %u, this one has %lu from seed %u\n",
+                path, header.bodies, header.seed, (unsigned long) bodies, seed);
+        fclose(file);
+        return false;
+    }
+
+    // Count is checked against what is really there, a corrupt one must not get to allocate()
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0)
+        size = ftell(file);
+    if (size < (long) sizeof(header) || fseek(file, sizeof(header), SEEK_SET) != 0 ||
+        header.particle_count != ((unsigned long) size - sizeof(header)) / sizeof(Particle)) {
+        fprintf(stderr, "Snapshot %s is truncated or corrupt\n", path);
+        fclose(file);
+        return false;
+    }
+
+    nbody.clear();
+    if (header.particle_count) {
+        Particle *particles = nbody.allocate(header.particle_count);
+        if (fread(particles, sizeof(Particle), header.particle_count, file) != header.particle_count) {
+            fprintf(stderr, "Snapshot %s is truncated\n", path);
+            nbody.clear();
+            fclose(file);
+            return false;
+        }
+    }
+    fclose(file);
+
+    state.days = header.days;
+    memcpy(state.camera, header.camera, sizeof(state.camera));
+    state.orbits = header.flags & SNAPSHOT_ORBITS;
+    state.nbody_mode = header.flags & SNAPSHOT_NBODY;
+    state.trails = header.flags & SNAPSHOT_TRAILS;
+    state.speed_factor = header.speed_factor;
+
+    return true;
+}
+
+bool snapshotSave(const char *path, const SnapshotState &state, const NBody &nbody, size_t bodies, unsigned seed) {
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    writer_idle.wait(lock, [] { return !image_pending; });
+
+    serialize(state, nbody, bodies, seed);
+    return writeImage(path);
+}
+
+void snapshotCheckpoint(const char *path, const SnapshotState &state, const NBody &nbody, size_t bodies, unsigned seed) {
+    std::unique_lock<std::mutex> lock(writer_mutex);
+    if (image_pending)
+        return; // Disk is slower than the interval, the next one will catch up
+
+    serialize(state, nbody, bodies, seed);
+    image_path = path;
+    image_pending = true;
+
+    if (!writer.joinable())
+        writer = std::thread(writerLoop);
+    writer_wake.notify_one();
+}
+
+void snapshotStop() {
+    {
+        std::unique_lock<std::mutex> lock(writer_mutex);
+        writer_quit = true;
+        writer_wake.notify_one();
+    }
+    if (writer.joinable())
+        writer.join();
+}
@@ -0,0 +1,51 @@
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+#include <stddef.h>
+
+#include "nbody.h"
+
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_INTERVAL 5000 // Between checkpoints, ms
+
+// Everything a session resumes from, apart from the particles
+struct SnapshotState {
+    double days;
+    GLfloat camera[9]; // Position, sight and up vectors
+    bool orbits, nbody_mode, trails;
+    int speed_factor;
+};
+
+/*
+ * Binary snapshots: a fixed 88-byte header followed by the N-body particles
+ * exactly as they lie in memory, so a restore is one read straight into the
+ * particle array. Planets and moons are functions of time and need nothing
+ * but the clock. Files are only read back by the same build on the same kind of
+ * machine, which the header checks along with the version, and a snapshot is
+ * only accepted by the scene it was taken in: same generator seed (0 for the
+ * Solar system) and number of bodies.
+ *
+ * Files are written to a temporary name, flushed to disk and renamed over the
+ * old snapshot, so a crash or power loss leaves either the old or the new one.
+ */
+
+// False if there is no usable snapshot, an invalid one is also reported on stderr
+bool snapshotLoad(const char *path, SnapshotState &state, NBody &nbody, size_t bodies, unsigned seed);
+
+// Blocks until written, e.g. on exit
+bool snapshotSave(const char *path, const SnapshotState &state, const NBody &nbody, size_t bodies, unsigned seed);
+
+// Copies the state and returns, the file is written by a background thread.
+// Skipped if the previous checkpoint is still being written.
+void snapshotCheckpoint(const char *path, const SnapshotState &state, const NBody &nbody, size_t bodies, unsigned seed);
+
+void snapshotStop(); // Waits for a checkpoint in progress and ends the writer thread
+
+#endif
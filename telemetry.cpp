@@ -0,0 +1,227 @@
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+
+#include <SDL.h>
+
+#include "telemetry.h"
+
+struct AtomicCounters {
+    std::atomic<unsigned long> allocations, frees;
+    std::atomic<unsigned long long> allocated_bytes;
+    std::atomic<unsigned long> gl_created, gl_deleted;
+    std::atomic<unsigned long long> upload_bytes;
+};
+
+static const char *subsystem_names[TELEMETRY_SUBSYSTEMS] = {"other", "physics", "scene", "hud"};
+
+// Zero-initialized before any constructor runs, so early allocations are safe to count
+static AtomicCounters current[TELEMETRY_SUBSYSTEMS];
+static TelemetryCounters last[TELEMETRY_SUBSYSTEMS], total[TELEMETRY_SUBSYSTEMS], peak[TELEMETRY_SUBSYSTEMS];
+static unsigned long frames = 0, zero_alloc_warmup = 0, violations = 0, first_violation = 0;
+static bool expect_zero_allocations = false;
+
+static thread_local TelemetrySubsystem scope = TELEMETRY_OTHER;
+
+TelemetryScope::TelemetryScope(TelemetrySubsystem subsystem) :
+    previous(scope)
+{
+    scope = subsystem;
+}
+
+TelemetryScope::~TelemetryScope() {
+    scope = previous;
+}
+
+static inline void countAllocation(size_t size) {
+    current[scope].allocations.fetch_add(1, std::memory_order_relaxed);
+    current[scope].allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+static inline void countFree() {
+    current[scope].frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+void *telemetryMalloc(size_t size) {
+    countAllocation(size);
+    return malloc(size);
+}
+
+void telemetryFree(void *ptr) {
+    if (ptr)
+        countFree();
+    free(ptr);
+}
+
+void telemetryCountGLCreate(unsigned long count) {
+    current[scope].gl_created.fetch_add(count, std::memory_order_relaxed);
+}
+
+void telemetryCountGLDelete(unsigned long count) {
+    current[scope].gl_deleted.fetch_add(count, std::memory_order_relaxed);
+}
+
+void telemetryCountUpload(unsigned long long bytes) {
+    current[scope].upload_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 7)
+static SDL_malloc_func sdl_malloc;
+static SDL_calloc_func sdl_calloc;
+static SDL_realloc_func sdl_realloc;
+static SDL_free_func sdl_free;
+
+static void *SDLCALL countedSDLMalloc(size_t size) {
+    countAllocation(size);
+    return sdl_malloc(size);
+}
+
+static void *SDLCALL countedSDLCalloc(size_t count, size_t size) {
+    countAllocation(count * size);
+    return sdl_calloc(count, size);
+}
+
+static void *SDLCALL countedSDLRealloc(void *ptr, size_t size) {
+    countAllocation(size);
+    if (ptr)
+        countFree();
+    return sdl_realloc(ptr, size);
+}
+
+static void SDLCALL countedSDLFree(void *ptr) {
+    if (ptr)
+        countFree();
+    sdl_free(ptr);
+}
+#endif
+
+void telemetryInit() {
+#if SDL_VERSION_ATLEAST(2, 0, 7)
+    SDL_GetMemoryFunctions(&sdl_malloc, &sdl_calloc, &sdl_realloc, &sdl_free);
+    SDL_SetMemoryFunctions(countedSDLMalloc, countedSDLCalloc, countedSDLRealloc, countedSDLFree);
+#endif
+}
+
+static void add(TelemetryCounters &to, const TelemetryCounters &what) {
+    to.allocations += what.allocations;
+    to.frees += what.frees;
+    to.allocated_bytes += what.allocated_bytes;
+    to.gl_created += what.gl_created;
+    to.gl_deleted += what.gl_deleted;
+    to.upload_bytes += what.upload_bytes;
+}
+
+void telemetryEndFrame() {
+    unsigned long allocations = 0;
+
+    for (int i = 0; i < TELEMETRY_SUBSYSTEMS; i++) {
+        TelemetryCounters &frame = last[i];
+        frame.allocations = current[i].allocations.exchange(0, std::memory_order_relaxed);
+        frame.frees = current[i].frees.exchange(0, std::memory_order_relaxed);
+        frame.allocated_bytes = current[i].allocated_bytes.exchange(0, std::memory_order_relaxed);
+        frame.gl_created = current[i].gl_created.exchange(0, std::memory_order_relaxed);
+        frame.gl_deleted = current[i].gl_deleted.exchange(0, std::memory_order_relaxed);
+        frame.upload_bytes = current[i].upload_bytes.exchange(0, std::memory_order_relaxed);
+
+        add(total[i], frame);
+        if (frame.allocations > peak[i].allocations)
+            peak[i].allocations = frame.allocations;
+        if (frame.allocated_bytes > peak[i].allocated_bytes)
+            peak[i].allocated_bytes = frame.allocated_bytes;
+        if (frame.gl_created > peak[i].gl_created)
+            peak[i].gl_created = frame.gl_created;
+        if (frame.upload_bytes > peak[i].upload_bytes)
+            peak[i].upload_bytes = frame.upload_bytes;
+
+        allocations += frame.allocations;
+    }
+
+    frames++;
+    if (expect_zero_allocations && frames > zero_alloc_warmup && allocations) {
+        if (!violations)
+            first_violation = frames;
+        violations++;
+    }
+}
+
+TelemetryCounters telemetryLastFrame() {
+    TelemetryCounters sum = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < TELEMETRY_SUBSYSTEMS; i++)
+        add(sum, last[i]);
+    return sum;
+}
+
+unsigned long telemetryFrames() {
+    return frames;
+}
+
+void telemetryExpectZeroAllocations(unsigned long warmup) {
+    expect_zero_allocations = true;
+    zero_alloc_warmup = warmup;
+}
+
+unsigned long telemetryViolations() {
+    return violations;
+}
+
+void telemetryDump(FILE *out) {
+    fprintf(out, "Telemetry over %lu frames:\n", frames);
+    fprintf(out, "%-10s %12s %12s %14s %10s %10s %14s %16s\n",
+            "subsystem", "allocs", "allocs/frame", "bytes/frame", "GL new", "GL delete", "upload/frame", "peak allocs/frame");
+
+    unsigned long divisor = frames ? frames : 1;
+    for (int i = 0; i < TELEMETRY_SUBSYSTEMS; i++)
+        fprintf(out, "%-10s %12lu %12.1f %14.1f %10lu %10lu %14.1f %16lu\n",
+                subsystem_names[i], total[i].allocations,
+                (double) total[i].allocations / divisor, (double) total[i].allocated_bytes / divisor,
+                total[i].gl_created, total[i].gl_deleted,
+                (double) total[i].upload_bytes / divisor, peak[i].allocations);
+
+    if (expect_zero_allocations)
+        fprintf(out, "Zero allocations per frame after %lu frames: %s (%lu frames allocated, first one is frame %lu)\n",
+                zero_alloc_warmup, violations ? "FAILED" : "passed", violations, first_violation);
+}
+
+/*
+ * Global allocation operators. Everything allocated with new in this program,
+ * the standard library included, passes through here.
+ */
+void *operator new(size_t size) {
+    countAllocation(size);
+    void *ptr = malloc(size ? size : 1);
+    if (!ptr)
+        throw std::bad_alloc();
+    return ptr;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    countAllocation(size);
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *ptr) noexcept {
+    if (ptr)
+        countFree();
+    free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+    operator delete(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+    operator delete(ptr);
+}
@@ -0,0 +1,61 @@
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * Per-frame counters of heap allocations, GL object churn and texture
+ * uploads, split by the subsystem that caused them.
+ *
+ * C++ allocations are counted by replacing global operator new/delete, SDL
+ * (and so SDL_ttf) ones through SDL_SetMemoryFunctions(). Plain malloc() in
+ * our own code goes through telemetryMalloc()/telemetryFree(), and GL calls
+ * that create or destroy objects are followed by the matching telemetryCount*
+ * call. Whatever is counted is charged to the subsystem of the innermost
+ * TelemetryScope on the current thread.
+ */
+
+enum TelemetrySubsystem {
+    TELEMETRY_OTHER, // Startup, input handling and anything not in a scope
+    TELEMETRY_PHYSICS,
+    TELEMETRY_SCENE,
+    TELEMETRY_HUD,
+    TELEMETRY_SUBSYSTEMS
+};
+
+struct TelemetryCounters {
+    unsigned long allocations, frees;
+    unsigned long long allocated_bytes;
+    unsigned long gl_created, gl_deleted; // Textures, quadrics, buffers...
+    unsigned long long upload_bytes;      // Texture data sent to the GPU
+};
+
+class TelemetryScope {
+public:
+    explicit TelemetryScope(TelemetrySubsystem subsystem);
+    ~TelemetryScope();
+private:
+    TelemetrySubsystem previous;
+};
+
+void telemetryInit(); // Must run before SDL_Init(), SDL does not allow swapping allocators later
+
+void *telemetryMalloc(size_t size);
+void telemetryFree(void *ptr);
+void telemetryCountGLCreate(unsigned long count = 1);
+void telemetryCountGLDelete(unsigned long count = 1);
+void telemetryCountUpload(unsigned long long bytes);
+
+void telemetryEndFrame();
+TelemetryCounters telemetryLastFrame(); // All subsystems together
+unsigned long telemetryFrames();
+
+// Steady-state check: every frame after `warmup` ones must allocate nothing
+void telemetryExpectZeroAllocations(unsigned long warmup);
+unsigned long telemetryViolations(); // Frames that broke the expectation above
+
+void telemetryDump(FILE *out);
+
+#endif
@@ -0,0 +1,161 @@
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "bmp_loader.h"
+#include "texture_manager.h"
+#include "telemetry.h"
+
+struct TextureEntry {
+    std::string path;
+    GLuint id;            // 0 while evicted or if the file could not be loaded
+    size_t bytes;         // GPU memory while resident
+    unsigned long refs;
+    unsigned long loads;  // First one plus reloads after evictions
+    unsigned long long last_used;
+    bool broken;          // Failed to load, not retried on every bind
+};
+
+// Never destroyed: bodies in static storage may still release their textures during static destruction
+static std::vector<TextureEntry> &entries = *new std::vector<TextureEntry>(); // Handle is index + 1
+static std::vector<size_t> &free_entries = *new std::vector<size_t>();
+static std::map<std::string, TextureHandle> &handles = *new std::map<std::string, TextureHandle>();
+
+static size_t budget = 0, resident_bytes = 0, peak_bytes = 0;
+static unsigned long long use_clock = 0; // Ticks on every bind
+static unsigned long evictions = 0;
+
+static void unload(TextureEntry &entry) {
+    glDeleteTextures(1, &entry.id);
+    telemetryCountGLDelete();
+    entry.id = 0;
+    resident_bytes -= entry.bytes;
+}
+
+// Least recently used first, there are few distinct textures so a scan is fine
+static void enforceBudget(size_t keep) {
+    while (budget && resident_bytes > budget) {
+        TextureEntry *victim = NULL;
+        for (size_t i = 0; i < entries.size(); i++)
+            if (i != keep && entries[i].id && (!victim || entries[i].last_used < victim->last_used))
+                victim = &entries[i];
+        if (!victim)
+            return; // What is left is the one texture being used, it has to stay
+
+        unload(*victim);
+        evictions++;
+    }
+}
+
+static void load(size_t index) {
+    TextureEntry &entry = entries[index];
+    entry.id = loadBMPTexture(entry.path.c_str());
+    if (!entry.id) {
+        entry.broken = true;
+        return;
+    }
+
+    // Loader leaves the new texture bound. Drivers keep RGB texels in four bytes
+    GLint width = 0, height = 0;
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    entry.bytes = 4 * (size_t) width * height;
+
+    entry.loads++;
+    entry.last_used = ++use_clock;
+    resident_bytes += entry.bytes;
+    if (resident_bytes > peak_bytes)
+        peak_bytes = resident_bytes;
+
+    enforceBudget(index);
+}
+
+TextureHandle acquireTexture(const char *path) {
+    auto found = handles.find(path);
+    if (found != handles.end()) {
+        entries[found->second - 1].refs++;
+        return found->second;
+    }
+
+    size_t index = entries.size();
+    if (free_entries.empty()) {
+        entries.push_back(TextureEntry());
+    } else {
+        index = free_entries.back();
+        free_entries.pop_back();
+    }
+
+    TextureEntry &entry = entries[index];
+    entry.path = path;
+    entry.id = 0;
+    entry.bytes = 0;
+    entry.refs = 1;
+    entry.loads = 0;
+    entry.last_used = 0;
+    entry.broken = false;
+
+    load(index); // Now rather than on the first bind, which would stall a frame
+    handles[entry.path] = index + 1;
+    return index + 1;
+}
+
+void releaseTexture(TextureHandle texture) {
+    if (!texture)
+        return;
+
+    TextureEntry &entry = entries[texture - 1];
+    if (--entry.refs)
+        return;
+
+    if (entry.id)
+        unload(entry);
+    handles.erase(entry.path);
+    entry.path.clear();
+    free_entries.push_back(texture - 1);
+}
+
+void bindTexture(TextureHandle texture) {
+    if (!texture) {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+
+    TextureEntry &entry = entries[texture - 1];
+    if (!entry.id && !entry.broken)
+        load(texture - 1);
+    entry.last_used = ++use_clock;
+    glBindTexture(GL_TEXTURE_2D, entry.id);
+}
+
+void setTextureBudget(size_t bytes) {
+    budget = bytes;
+    enforceBudget((size_t) -1);
+}
+
+void textureDump(FILE *out) {
+    size_t count = 0, resident = 0;
+    for (auto it = entries.begin(); it != entries.end(); it++)
+        if (it->refs) {
+            count++;
+            resident += it->id != 0;
+        }
+
+    fprintf(out, "Textures: %lu, %lu resident, %.1f KB of ", (unsigned long) count, (unsigned long) resident, resident_bytes / 1024.0);
+    if (budget)
+        fprintf(out, "%.1f KB budget", budget / 1024.0);
+    else
+        fprintf(out, "unlimited budget");
+    fprintf(out, ", peak %.1f KB, %lu evictions\n", peak_bytes / 1024.0, evictions);
+
+    fprintf(out, "%-32s %6s %10s %6s %8s\n", "texture", "refs", "KB", "loads", "resident");
+    for (auto it = entries.begin(); it != entries.end(); it++)
+        if (it->refs)
+            fprintf(out, "%-32s %6lu %10.1f %6lu %8s\n", it->path.c_str(), it->refs, it->bytes / 1024.0, it->loads,
+                    it->broken ? "failed" : it->id ? "yes" : "no");
+}
@@ -0,0 +1,32 @@
+
+#ifndef TEXTURE_MANAGER_H
+#define TEXTURE_MANAGER_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+typedef size_t TextureHandle; // 0 is no texture
+
+/*
+ * Textures loaded from files, shared by path. Every acquireTexture() of the
+ * same path returns the same handle and only the first one touches the disk;
+ * the texture goes away with the last releaseTexture().
+ *
+ * GPU memory is accounted per texture. With a budget set, textures that were
+ * bound least recently are evicted whenever loading one more would go over
+ * it, and bindTexture() loads them back from their file when needed again.
+ * The size of a texture is only known once it is loaded, so the budget is
+ * briefly exceeded by at most that texture.
+ * A frame that draws more than the budget holds keeps reloading, so the
+ * budget is meant to hold at least one frame's worth of textures.
+ *
+ * All of these need the GL context of the thread that renders.
+ */
+TextureHandle acquireTexture(const char *path);
+void releaseTexture(TextureHandle texture);
+void bindTexture(TextureHandle texture); // To GL_TEXTURE_2D, 0 unbinds
+
+void setTextureBudget(size_t bytes); // 0 is unlimited
+void textureDump(FILE *out); // Memory, references and evictions of every texture
+
+#endif
@@ -0,0 +1,135 @@
+#include "thread_pool.h"
+
+static thread_local bool inside_pool = false;
+
+ThreadPool::ThreadPool(unsigned threads) :
+    queues(threads ? threads : (std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1)),
+    generation(0),
+    stopping(false),
+    pending(0)
+{
+    for (unsigned i = 1; i < queues.size(); i++)
+        workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (auto it = workers.begin(); it != workers.end(); it++)
+        it->join();
+}
+
+void ThreadPool::parallelFor(size_t count, size_t grain, const RangeFunction &body) {
+    if (!count)
+        return;
+    if (!grain)
+        grain = 1;
+
+    size_t chunks = (count + grain - 1) / grain;
+
+    // Nested loops and tiny ones are not worth waking anybody up
+    if (inside_pool || workers.empty() || chunks == 1) {
+        body(0, count);
+        return;
+    }
+
+    std::lock_guard<std::mutex> job_lock(job_mutex);
+
+    // All queues are drained by now, rewind them without giving memory back
+    for (auto it = queues.begin(); it != queues.end(); it++) {
+        std::lock_guard<std::mutex> lock(it->mutex);
+        it->tasks.clear();
+        it->head = 0;
+    }
+
+    // Deal contiguous runs of chunks, so each worker starts on neighbouring memory
+    size_t per_queue = (chunks + queues.size() - 1) / queues.size();
+    pending = chunks;
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        Task task = {chunk * grain, chunk * grain + grain < count ? chunk * grain + grain : count, &body};
+        Queue &queue = queues[chunk / per_queue];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(task);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        generation++;
+    }
+    wake.notify_all();
+
+    inside_pool = true;
+    while (runTask(0))
+        ;
+    inside_pool = false;
+
+    std::unique_lock<std::mutex> lock(wake_mutex);
+    while (pending)
+        done.wait(lock);
+}
+
+bool ThreadPool::runTask(unsigned index) {
+    Task task;
+    bool found = false;
+
+    // Own queue first, from the front...
+    {
+        Queue &own = queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.head < own.tasks.size()) {
+            task = own.tasks[own.head++];
+            found = true;
+        }
+    }
+
+    // ...then steal from the back of somebody else's
+    for (size_t i = 1; !found && i < queues.size(); i++) {
+        Queue &victim = queues[(index + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.head < victim.tasks.size()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            found = true;
+        }
+    }
+
+    if (!found)
+        return false;
+
+    (*task.body)(task.begin, task.end);
+
+    if (--pending == 0) {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        done.notify_all();
+    }
+
+    return true;
+}
+
+void ThreadPool::workerLoop(unsigned index) {
+    inside_pool = true;
+    unsigned seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            while (!stopping && seen == generation)
+                wake.wait(lock);
+            if (stopping)
+                return;
+            seen = generation;
+        }
+
+        while (runTask(index))
+            ;
+    }
+}
+
+ThreadPool &threadPool() {
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,63 @@
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <stddef.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Work-stealing pool for data-parallel loops. parallelFor() splits [0, count)
+ * into chunks of `grain` items and deals contiguous runs of them to per-worker
+ * queues. Each worker eats its own queue from the front and, once it is empty,
+ * steals from the back of the others, so uneven chunks (e.g. Barnes-Hut walks
+ * of different depth) still keep all cores busy. The calling thread takes part
+ * in the work too.
+ */
+class ThreadPool {
+public:
+    typedef std::function<void(size_t begin, size_t end)> RangeFunction;
+
+    explicit ThreadPool(unsigned threads = 0); // 0 means one thread per core
+    ~ThreadPool();
+
+    void parallelFor(size_t count, size_t grain, const RangeFunction &body);
+    unsigned size() const { return workers.size() + 1; }
+
+private:
+    struct Task {
+        size_t begin, end;
+        const RangeFunction *body;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::vector<Task> tasks; // Live ones are [head, size), capacity is kept between loops
+        size_t head;
+        Queue() : head(0) {}
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<Queue> queues; // queues[0] belongs to the calling thread
+
+    std::mutex job_mutex; // Serializes parallelFor calls
+    std::mutex wake_mutex;
+    std::condition_variable wake, done;
+    unsigned generation;
+    bool stopping;
+    std::atomic<size_t> pending;
+
+    void workerLoop(unsigned index);
+    bool runTask(unsigned index);
+
+    ThreadPool(const ThreadPool &);
+    ThreadPool &operator=(const ThreadPool &);
+};
+
+ThreadPool &threadPool(); // Shared pool, created on first use
+
+#endif
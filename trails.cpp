@@ -0,0 +1,263 @@
+#include <string.h>
+
+#include "trails.h"
+#include "telemetry.h"
+
+#define TRAIL_RAMP_SIZE 256
+#define TRAIL_FENCE_TIMEOUT 100000000 // The draw that reads a slot is a frame old by the time it is rewritten, ns
+
+// Offsets into buffer objects are passed where pointers are expected
+#define BUFFER_OFFSET(offset) ((const GLvoid*) (offset))
+
+TrailBuffer::TrailBuffer() :
+    body_count(0),
+    sample_count(0),
+    head(0),
+    filled(0),
+    vertex_buffer(0),
+    texcoord_buffer(0),
+    index_buffer(0),
+    ramp(0),
+    mapped(NULL),
+    fence(NULL)
+{
+}
+
+void TrailBuffer::allocate(size_t bodies, size_t samples) {
+    release();
+    if (!bodies || samples < 2)
+        return;
+
+    body_count = bodies;
+    sample_count = samples;
+
+    size_t slots = samples + 1; // Last one mirrors slot 0
+    size_t vertex_count = slots * bodies;
+
+    // Texture coordinate is the slot, so the ramp only has to slide as the ring turns
+    texcoords.resize(vertex_count);
+    for (size_t slot = 0; slot < slots; slot++)
+        for (size_t body = 0; body < bodies; body++)
+            texcoords[slot * bodies + body] = (GLfloat) slot / samples;
+
+    // Segment p joins slots p and p + 1 of every body, segments are grouped by p
+    indices.resize(2 * samples * bodies);
+    for (size_t segment = 0; segment < samples; segment++)
+        for (size_t body = 0; body < bodies; body++) {
+            indices[2 * (segment * bodies + body)] = segment * bodies + body;
+            indices[2 * (segment * bodies + body) + 1] = (segment + 1) * bodies + body;
+        }
+
+    GLubyte alpha[TRAIL_RAMP_SIZE];
+    for (int i = 0; i < TRAIL_RAMP_SIZE; i++)
+        alpha[i] = 255 * i / (TRAIL_RAMP_SIZE - 1);
+
+    glGenTextures(1, &ramp);
+    telemetryCountGLCreate();
+    glBindTexture(GL_TEXTURE_1D, ramp);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_ALPHA, TRAIL_RAMP_SIZE, 0, GL_ALPHA, GL_UNSIGNED_BYTE, alpha);
+    telemetryCountUpload(sizeof(alpha));
+    glBindTexture(GL_TEXTURE_1D, 0);
+
+    if (!glHasBuffers) {
+        vertices.resize(3 * vertex_count);
+        return;
+    }
+
+    GLuint buffers[3];
+    pglGenBuffers(3, buffers);
+    telemetryCountGLCreate(3);
+    vertex_buffer = buffers[0];
+    texcoord_buffer = buffers[1];
+    index_buffer = buffers[2];
+
+    // Static parts go to the GPU once and are not needed here any more
+    pglBindBuffer(GL_ARRAY_BUFFER, texcoord_buffer);
+    pglBufferData(GL_ARRAY_BUFFER, texcoords.size() * sizeof(GLfloat), &texcoords[0], GL_STATIC_DRAW);
+    telemetryCountUpload(texcoords.size() * sizeof(GLfloat));
+    std::vector<GLfloat>().swap(texcoords);
+
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+    pglBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+    telemetryCountUpload(indices.size() * sizeof(GLuint));
+    pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    std::vector<GLuint>().swap(indices);
+
+    GLsizeiptr size = 3 * vertex_count * sizeof(GLfloat);
+    pglBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+    if (glHasBufferStorage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        pglBufferStorage(GL_ARRAY_BUFFER, size, NULL, flags);
+        mapped = (GLfloat*) pglMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags);
+        if (!mapped) { // Storage is immutable now, a fresh buffer is needed for the fallback below
+            pglDeleteBuffers(1, &vertex_buffer);
+            pglGenBuffers(1, &vertex_buffer);
+            pglBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+            telemetryCountGLDelete();
+            telemetryCountGLCreate();
+        }
+    }
+    if (!mapped) {
+        pglBufferData(GL_ARRAY_BUFFER, size, NULL, GL_DYNAMIC_DRAW);
+        staging.resize(3 * bodies);
+    }
+    pglBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void TrailBuffer::release() {
+    if (fence)
+        pglDeleteSync(fence);
+    fence = NULL;
+
+    if (vertex_buffer) {
+        if (mapped) {
+            pglBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+            pglUnmapBuffer(GL_ARRAY_BUFFER);
+            pglBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        GLuint buffers[3] = {vertex_buffer, texcoord_buffer, index_buffer};
+        pglDeleteBuffers(3, buffers);
+        telemetryCountGLDelete(3);
+    }
+    vertex_buffer = texcoord_buffer = index_buffer = 0;
+    mapped = NULL;
+
+    if (ramp) {
+        glDeleteTextures(1, &ramp);
+        telemetryCountGLDelete();
+    }
+    ramp = 0;
+
+    std::vector<GLfloat>().swap(vertices);
+    std::vector<GLfloat>().swap(texcoords);
+    std::vector<GLfloat>().swap(staging);
+    std::vector<GLuint>().swap(indices);
+    body_count = sample_count = 0;
+    head = filled = 0;
+}
+
+void TrailBuffer::clear() {
+    head = filled = 0;
+}
+
+GLfloat *TrailBuffer::beginAppend() {
+    if (!body_count)
+        return NULL;
+
+    if (mapped) {
+        // Normally signalled long ago, this only waits if the GPU is more than a frame behind
+        if (fence) {
+            pglClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, TRAIL_FENCE_TIMEOUT);
+            pglDeleteSync(fence);
+            fence = NULL;
+        }
+        return mapped + 3 * head * body_count;
+    }
+
+    if (vertex_buffer)
+        return &staging[0];
+    return &vertices[3 * head * body_count];
+}
+
+void TrailBuffer::endAppend() {
+    size_t size = 3 * body_count * sizeof(GLfloat);
+    size_t offset = head * size, mirror = sample_count * size;
+
+    if (mapped) {
+        if (!head)
+            memcpy((GLubyte*) mapped + mirror, mapped, size);
+    } else if (vertex_buffer) {
+        pglBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+        pglBufferSubData(GL_ARRAY_BUFFER, offset, size, &staging[0]);
+        if (!head)
+            pglBufferSubData(GL_ARRAY_BUFFER, mirror, size, &staging[0]);
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+    } else if (!head) {
+        memcpy(&vertices[3 * sample_count * body_count], &vertices[0], size);
+    }
+    telemetryCountUpload(head ? size : 2 * size);
+
+    head = (head + 1) % sample_count;
+    if (filled < sample_count)
+        filled++;
+}
+
+void TrailBuffer::render(GLfloat r, GLfloat g, GLfloat b) {
+    if (filled < 2)
+        return;
+
+    // Segments to draw, all but the one from the newest sample back to the oldest
+    GLsizei counts[2];
+    const GLvoid *offsets[2];
+    GLsizei ranges = 0;
+    size_t seam = filled < sample_count ? filled - 1 : (head + sample_count - 1) % sample_count;
+    size_t begin[2] = {0, seam + 1}, end[2] = {seam, filled < sample_count ? seam + 1 : sample_count};
+    for (int i = 0; i < 2; i++)
+        if (end[i] > begin[i]) {
+            counts[ranges] = 2 * (end[i] - begin[i]) * body_count;
+            offsets[ranges] = vertex_buffer ? BUFFER_OFFSET(2 * begin[i] * body_count * sizeof(GLuint)) :
+                                              (const GLvoid*) &indices[2 * begin[i] * body_count];
+            ranges++;
+        }
+    if (!ranges)
+        return;
+
+    glDisable(GL_LIGHTING);
+    glDisable(GL_TEXTURE_2D);
+    glEnable(GL_TEXTURE_1D);
+    glBindTexture(GL_TEXTURE_1D, ramp);
+    glDepthMask(GL_FALSE); // Translucent, must not hide what is drawn after
+    glColor4f(r, g, b, 1.0f);
+
+    glMatrixMode(GL_TEXTURE);
+    glPushMatrix();
+    glLoadIdentity();
+    glTranslatef(-(GLfloat) head / sample_count, 0.0f, 0.0f); // Newest sample lands just below 1, oldest at 0
+    glMatrixMode(GL_MODELVIEW);
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    if (vertex_buffer) {
+        pglBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+        glVertexPointer(3, GL_FLOAT, 0, BUFFER_OFFSET(0));
+        pglBindBuffer(GL_ARRAY_BUFFER, texcoord_buffer);
+        glTexCoordPointer(1, GL_FLOAT, 0, BUFFER_OFFSET(0));
+        pglBindBuffer(GL_ARRAY_BUFFER, 0);
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+    } else {
+        glVertexPointer(3, GL_FLOAT, 0, &vertices[0]);
+        glTexCoordPointer(1, GL_FLOAT, 0, &texcoords[0]);
+    }
+
+    if (glHasMultiDraw) {
+        pglMultiDrawElements(GL_LINES, counts, GL_UNSIGNED_INT, offsets, ranges);
+    } else {
+        for (GLsizei i = 0; i < ranges; i++)
+            glDrawElements(GL_LINES, counts[i], GL_UNSIGNED_INT, offsets[i]);
+    }
+
+    if (vertex_buffer)
+        pglBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    if (mapped) {
+        if (fence)
+            pglDeleteSync(fence);
+        fence = pglFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    glMatrixMode(GL_TEXTURE);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+
+    glDepthMask(GL_TRUE);
+    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
+    glBindTexture(GL_TEXTURE_1D, 0);
+    glDisable(GL_TEXTURE_1D);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_LIGHTING);
+}
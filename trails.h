@@ -0,0 +1,65 @@
+
+#ifndef TRAILS_H
+#define TRAILS_H
+
+// windows.h must be included before GL headers
+#ifdef _MSC_VER
+#include <windows.h>
+#endif
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "gl_extensions.h"
+
+/*
+ * Position history of a class of bodies (planets, particles...) kept on the
+ * GPU as a ring of samples. A sample is one contiguous block of positions of
+ * all bodies, so appending one costs the same small upload every time, no
+ * matter how long the history is, and nothing is ever reallocated or sent
+ * again. With ARB_buffer_storage the ring is mapped once for good and samples
+ * are written straight into it.
+ *
+ * Slot `samples` mirrors slot 0, so every segment of every trail is a pair of
+ * neighbouring slots and a static index buffer describes all of them. The
+ * segment joining the newest and the oldest sample is the only one skipped,
+ * which leaves at most two index ranges, drawn with a single call. Alpha
+ * fades with age through a 1D ramp texture whose coordinate is the slot,
+ * shifted by the texture matrix as the ring turns.
+ */
+class TrailBuffer {
+public:
+    TrailBuffer();
+
+    void allocate(size_t bodies, size_t samples); // Needs a GL context, drops the history
+    void release(); // Also needs the context, so it is not left to a destructor
+    void clear(); // Drops the history, keeps the storage
+
+    // Room for 3 * bodies() floats of the next sample, commit it with endAppend()
+    GLfloat *beginAppend();
+    void endAppend();
+
+    void render(GLfloat r, GLfloat g, GLfloat b);
+
+    size_t bodies() const { return body_count; }
+
+private:
+    size_t body_count, sample_count;
+    size_t head;    // Slot the next sample goes to
+    size_t filled;  // Samples written so far, up to sample_count
+
+    GLuint vertex_buffer, texcoord_buffer, index_buffer;
+    GLuint ramp;      // 1D alpha texture
+    GLfloat *mapped;  // Persistent mapping of vertex_buffer
+    GLsync fence;     // Last draw that read from the mapping
+
+    // Client-side copies when buffer objects are missing, staging area for glBufferSubData() otherwise
+    std::vector<GLfloat> vertices, texcoords, staging;
+    std::vector<GLuint> indices;
+
+    TrailBuffer(const TrailBuffer &);
+    TrailBuffer &operator=(const TrailBuffer &);
+};
+
+#endif